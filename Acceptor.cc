@@ -1,6 +1,7 @@
 #include "Acceptor.h"
 
-#include <error.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -9,6 +10,18 @@
 #include "InetAddress.h"
 #include "Logger.h"
 
+static int dupListenFd(int listenfd) {
+    int sockfd = ::fcntl(listenfd, F_DUPFD_CLOEXEC, 0);
+    if (sockfd < 0) {
+        LOG_FATAL("%s:%s:%d listen socket dup error:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+static int openIdleFd() {
+    return ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
 static int createNonblocking() {
     int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (sockfd < 0) {
@@ -18,16 +31,25 @@ static int createNonblocking() {
 }
 
 Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport)
-    : loop_(loop), acceptSocket_(createNonblocking()), acceptChannel_(loop, acceptSocket_.fd()), listenning_(false) {
+    : loop_(loop), acceptSocket_(createNonblocking()), acceptChannel_(loop, acceptSocket_.fd()), listenning_(false), idleFd_(openIdleFd()) {
     acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    acceptSocket_.setReusePort(reuseport);
+    // accept得到的socket继承监听socket的SO_KEEPALIVE，不需要每个连接再调用一次setsockopt
+    acceptSocket_.setKeepAlive(true);
     acceptSocket_.bindAddress(listenAddr);
     acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
 }
 
+Acceptor::Acceptor(EventLoop *loop, int listenfd)
+    : loop_(loop), acceptSocket_(dupListenFd(listenfd)), acceptChannel_(loop, acceptSocket_.fd()), listenning_(false), idleFd_(openIdleFd()) {
+    acceptChannel_.setExclusive(true);
+    acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
+}
+
 Acceptor::~Acceptor() {
     acceptChannel_.disableAll();
     acceptChannel_.remove();
+    ::close(idleFd_);
 }
 
 void Acceptor::listen() {
@@ -37,20 +59,48 @@ void Acceptor::listen() {
 }
 
 // listenfd有事件发生了，即有新用户连接
+// 一次最多接受kMaxAcceptsPerEvent个连接，接受完之后再一起交给回调
 void Acceptor::handleRead() {
-    InetAddress peerAddr;
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if (connfd >= 0) {
-        if (newConnectionCallback_) {
+    accepted_.clear();
+    for (int i = 0; i < kMaxAcceptsPerEvent; ++i) {
+        InetAddress peerAddr;
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd >= 0) {
+            accepted_.push_back(AcceptedConnection{connfd, peerAddr});
+            continue;
+        }
+
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) {
+            // 已经没有等待的连接，多个loop共享监听socket时没有抢到连接的loop也会得到EAGAIN
+            break;
+        } else if (savedErrno == EMFILE || savedErrno == ENFILE) {
+            LOG_ERROR("%s:%s:%d sockfd reached limit\n", __FILE__, __FUNCTION__, __LINE__);
+            // fd耗尽时连接一直留在队列中，监听socket一直可读，loop会空转
+            // 释放预留的fd接受这个连接并立即关闭，再重新预留
+            ::close(idleFd_);
+            idleFd_ = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+            ::close(idleFd_);
+            idleFd_ = openIdleFd();
+        } else if (savedErrno != ECONNABORTED && savedErrno != EINTR) {
+            LOG_ERROR("%s:%s:%d accept error:%d\n", __FILE__, __FUNCTION__, __LINE__, savedErrno);
+            break;
+        }
+    }
+
+    if (accepted_.empty()) {
+        return;
+    }
+    if (newConnectionBatchCallback_) {
+        newConnectionBatchCallback_(accepted_);
+    } else if (newConnectionCallback_) {
+        for (const AcceptedConnection &conn : accepted_) {
             // 轮询找到subloop，唤醒，分发当前新客户端的Channel
-            newConnectionCallback_(connfd, peerAddr);
-        } else {
-            ::close(connfd);
+            newConnectionCallback_(conn.sockfd, conn.peerAddr);
         }
     } else {
-        LOG_ERROR("%s:%s:%d accept error:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
-        if (errno = EMFILE) {
-            LOG_ERROR("%s:%s:%d sockfd reached limit\n", __FILE__, __FUNCTION__, __LINE__);
+        for (const AcceptedConnection &conn : accepted_) {
+            ::close(conn.sockfd);
         }
     }
-}
\ No newline at end of file
+}
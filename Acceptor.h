@@ -1,21 +1,46 @@
 #pragma once
+#include <vector>
+
 #include "Channel.h"
+#include "InetAddress.h"
 #include "Socket.h"
 #include "nocopyable.h"
 
 class EventLoop;
-class InetAddress;
 
 class Acceptor {
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress &addr)>;
+
+    struct AcceptedConnection {
+        int sockfd;
+        InetAddress peerAddr;
+    };
+    using AcceptedList = std::vector<AcceptedConnection>;
+    // 一次可读事件中接受的所有连接
+    using NewConnectionBatchCallback = std::function<void(const AcceptedList &accepted)>;
+
+    // 一次可读事件最多接受的连接数，连接突发时减少epoll_wait的次数，又不至于长时间占用loop
+    static const int kMaxAcceptsPerEvent = 64;
+
     Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
+    // 和其他loop共享同一个监听socket，内部dup一份listenfd，通过EPOLLEXCLUSIVE每次只唤醒一个loop
+    Acceptor(EventLoop *loop, int listenfd);
     ~Acceptor();
     void setNewConnectionCallback(const NewConnectionCallback &cb) {
         newConnectionCallback_ = std::move(cb);
     }
+    // 设置之后代替NewConnectionCallback，连接成批交给调用者
+    void setNewConnectionBatchCallback(const NewConnectionBatchCallback &cb) {
+        newConnectionBatchCallback_ = cb;
+    }
 
     bool listenning() const { return listenning_; }
+    int listenFd() const { return acceptSocket_.fd(); }
+    // SO_REUSEPORT监听组中按照cpu选择监听socket，见Socket::attachReusePortCpuProgram
+    bool attachCpuSteeringProgram(const std::vector<int> &indexOfCpu) {
+        return acceptSocket_.attachReusePortCpuProgram(indexOfCpu);
+    }
     void listen();
 
 private:
@@ -25,6 +50,8 @@ private:
     Socket acceptSocket_;
     Channel acceptChannel_;
     NewConnectionCallback newConnectionCallback_;
+    NewConnectionBatchCallback newConnectionBatchCallback_;
+    AcceptedList accepted_;  // 复用的连接列表，避免每次事件分配内存
     bool listenning_;
-    int idleFd_;
+    int idleFd_;  // 预留的fd，进程fd耗尽时用来接受并关闭连接
 };
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "AsyncLogging.h"
+
+#include <stdio.h>
+
+#include <chrono>
+
+#include "LogFile.h"
+
+AsyncLogging::AsyncLogging(const std::string &basename, off_t rollSize, int flushInterval)
+    : flushInterval_(flushInterval)
+    , running_(false)
+    , basename_(basename)
+    , rollSize_(rollSize)
+    , thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging")
+    , currentBuffer_(new LogBuffer)
+    , nextBuffer_(new LogBuffer)
+    , flushRequested_(0)
+    , flushed_(0)
+    , droppedBytes_(0) {
+    buffers_.reserve(kMaxPendingBuffers);
+}
+
+AsyncLogging::~AsyncLogging() {
+    if (running_) {
+        stop();
+    }
+}
+
+void AsyncLogging::start() {
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogging::stop() {
+    running_ = false;
+    cond_.notify_one();
+    thread_.join();
+    // 后端线程退出前的最后一轮已经写完了所有日志
+    std::lock_guard<std::mutex> lock(mutex_);
+    flushCond_.notify_all();
+}
+
+void AsyncLogging::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!running_) {
+        return;
+    }
+    uint64_t ticket = ++flushRequested_;
+    cond_.notify_one();
+    flushCond_.wait(lock, [this, ticket] { return flushed_ >= ticket || !running_; });
+}
+
+void AsyncLogging::append(const char *logline, int len) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (currentBuffer_->avail() > len) {
+        currentBuffer_->append(logline, len);
+        return;
+    }
+
+    // 后端已经积压了太多缓冲区，直接丢弃这条日志
+    if (buffers_.size() >= kMaxPendingBuffers) {
+        droppedBytes_ += len;
+        return;
+    }
+
+    buffers_.push_back(std::move(currentBuffer_));
+    if (nextBuffer_) {
+        currentBuffer_ = std::move(nextBuffer_);
+    } else {
+        // 前端写得太快，两块缓冲区都用完了，只能重新分配
+        currentBuffer_.reset(new LogBuffer);
+    }
+    currentBuffer_->append(logline, len);
+    cond_.notify_one();
+}
+
+// 后端日志线程
+void AsyncLogging::threadFunc() {
+    LogFile output(basename_, rollSize_);
+    BufferPtr newBuffer1(new LogBuffer);
+    BufferPtr newBuffer2(new LogBuffer);
+    BufferVector buffersToWrite;
+    buffersToWrite.reserve(kMaxPendingBuffers + 1);
+    size_t reportedDropped = 0;
+
+    bool more = true;
+    while (more) {
+        more = running_;
+        uint64_t flushing = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (more && buffers_.empty() && flushRequested_ == flushed_) {
+                cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+            }
+            // 这一轮写完之后，在此之前请求的flush都完成了
+            flushing = flushRequested_;
+            buffers_.push_back(std::move(currentBuffer_));
+            currentBuffer_ = std::move(newBuffer1);
+            buffersToWrite.swap(buffers_);
+            if (!nextBuffer_) {
+                nextBuffer_ = std::move(newBuffer2);
+            }
+        }
+
+        // 记录被丢弃的日志量，方便排查
+        size_t dropped = droppedBytes_;
+        if (dropped != reportedDropped) {
+            char buf[128];
+            int n = snprintf(buf, sizeof(buf), "Dropped %lu bytes of log messages\n",
+                             static_cast<unsigned long>(dropped - reportedDropped));
+            output.append(buf, n);
+            reportedDropped = dropped;
+        }
+
+        for (const BufferPtr &buffer : buffersToWrite) {
+            output.append(buffer->data(), buffer->length());
+        }
+
+        // 只保留两块缓冲区用于下一轮交换，其余释放掉
+        if (buffersToWrite.size() > 2) {
+            buffersToWrite.resize(2);
+        }
+        if (!newBuffer1) {
+            newBuffer1 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer1->reset();
+        }
+        if (!newBuffer2) {
+            newBuffer2 = std::move(buffersToWrite.back());
+            buffersToWrite.pop_back();
+            newBuffer2->reset();
+        }
+        buffersToWrite.clear();
+        output.flush();
+
+        if (flushing != 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            flushed_ = flushing;
+            flushCond_.notify_all();
+        }
+    }
+}
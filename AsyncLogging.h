@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Thread.h"
+#include "nocopyable.h"
+
+// 固定大小的日志缓冲区，前端不断往里追加日志，写满后整块交给后端线程
+template <int SIZE>
+class FixedBuffer : nocopyable {
+public:
+    FixedBuffer() : cur_(data_) {}
+
+    void append(const char *buf, size_t len) {
+        if (static_cast<size_t>(avail()) > len) {
+            memcpy(cur_, buf, len);
+            cur_ += len;
+        }
+    }
+
+    const char *data() const { return data_; }
+    int length() const { return static_cast<int>(cur_ - data_); }
+    int avail() const { return static_cast<int>(end() - cur_); }
+    void reset() { cur_ = data_; }
+
+private:
+    const char *end() const { return data_ + sizeof(data_); }
+
+    char data_[SIZE];
+    char *cur_;
+};
+
+/**
+ * 异步日志，采用双缓冲技术
+ * 前端(loop线程)只负责把日志拷贝到内存缓冲区，不会阻塞在磁盘IO上
+ * 后端线程定期或者在缓冲区写满时，把日志批量写入滚动的日志文件
+ *
+ * 用法:
+ *   AsyncLogging log("server", 500 * 1000 * 1000);
+ *   log.start();
+ *   Logger::setOutput(...); // 在输出函数中调用log.append
+ *   Logger::setFlush(...);  // 在刷新函数中调用log.flush，否则ERROR/FATAL日志可能在进程退出时还在内存中
+ */
+class AsyncLogging : nocopyable {
+public:
+    AsyncLogging(const std::string &basename, off_t rollSize, int flushInterval = 3);
+    ~AsyncLogging();
+
+    // 前端写日志，线程安全
+    void append(const char *logline, int len);
+
+    void start();
+    void stop();
+
+    // 把当前缓冲区交给后端，阻塞到后端写入并刷新了文件为止，线程安全
+    // 通过Logger::setFlush安装之后，LOG_FATAL在exit之前日志已经落地
+    void flush();
+
+    // 后端来不及处理而被丢弃的日志字节数
+    size_t droppedBytes() const { return droppedBytes_; }
+
+private:
+    void threadFunc();
+
+    static const int kLargeBuffer = 4000 * 1000;
+    // 积压的缓冲区达到该数量后，前端开始丢弃日志，保证内存占用有上界
+    static const size_t kMaxPendingBuffers = 16;
+
+    using LogBuffer = FixedBuffer<kLargeBuffer>;
+    using BufferPtr = std::unique_ptr<LogBuffer>;
+    using BufferVector = std::vector<BufferPtr>;
+
+    const int flushInterval_;
+    std::atomic_bool running_;
+    const std::string basename_;
+    const off_t rollSize_;
+    Thread thread_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    BufferPtr currentBuffer_;  // 当前正在写的缓冲区
+    BufferPtr nextBuffer_;     // 预备缓冲区
+    BufferVector buffers_;     // 已写满，等待后端写入文件的缓冲区
+    std::condition_variable flushCond_;
+    uint64_t flushRequested_;  // flush请求的序号
+    uint64_t flushed_;         // 后端已经完成的最大flush序号
+    std::atomic<size_t> droppedBytes_;
+};
@@ -1,14 +1,120 @@
 #include "Buffer.h"
 
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/uio.h>
+
+#include "BufferPool.h"
+#include "Logger.h"
+
+const size_t Buffer::kCheapPrepend;
+const size_t Buffer::kInitialSize;
+const size_t Buffer::kExtraBufSize;
+char Buffer::emptyStorage_[Buffer::kCheapPrepend];
+
+Buffer::Buffer(size_t initialSize)
+    : data_(emptyStorage_), capacity_(kCheapPrepend), readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend)
+    , pool_(nullptr) {
+    data_ = allocate(kCheapPrepend + initialSize, &capacity_);
+}
+
+Buffer::Buffer(BufferPool *pool)
+    : data_(emptyStorage_), capacity_(kCheapPrepend), readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend)
+    , pool_(pool) {}
+
+Buffer::~Buffer() {
+    if (hasStorage()) {
+        releaseStorage();
+    }
+}
+
+Buffer::Buffer(const Buffer &rhs) : Buffer(rhs.readableBytes()) {
+    append(rhs.peek(), rhs.readableBytes());
+}
+
+Buffer::Buffer(Buffer &&rhs)
+    : data_(rhs.data_), capacity_(rhs.capacity_), readerIndex_(rhs.readerIndex_), writerIndex_(rhs.writerIndex_)
+    , pool_(nullptr) {
+    rhs.data_ = emptyStorage_;
+    rhs.capacity_ = kCheapPrepend;
+    rhs.readerIndex_ = rhs.writerIndex_ = kCheapPrepend;
+}
+
+char *Buffer::allocate(size_t size, size_t *capacity) {
+    if (pool_) {
+        return pool_->acquire(size, capacity);
+    }
+    char *data = static_cast<char *>(::malloc(size));
+    if (data == nullptr) {
+        LOG_FATAL("Buffer::malloc %zu bytes failed\n", size);
+    }
+    *capacity = size;
+    return data;
+}
+
+void Buffer::releaseStorage() {
+    if (pool_) {
+        pool_->release(data_, capacity_);
+    } else {
+        ::free(data_);
+    }
+    data_ = emptyStorage_;
+    capacity_ = kCheapPrepend;
+}
+
+void Buffer::makeSpace(size_t len) {
+    if (hasStorage() && writableBytes() + prependableBytes() >= len + kCheapPrepend) {
+        // 前面已经读走的空间足够，把可读数据搬到前面
+        size_t readable = readableBytes();
+        ::memmove(begin() + kCheapPrepend, begin() + readerIndex_, readable);
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = readerIndex_ + readable;
+    } else {
+        // 至少翻倍，连续追加小块数据时均摊的拷贝次数是常数
+        size_t size = kCheapPrepend + readableBytes() + len;
+        if (hasStorage()) {
+            size = std::max(size, capacity_ * 2);
+        }
+        reallocate(size);
+    }
+}
+
+void Buffer::reallocate(size_t size) {
+    size_t readable = readableBytes();
+    size_t capacity = 0;
+    char *data = allocate(size, &capacity);
+    ::memcpy(data + kCheapPrepend, peek(), readable);
+    if (hasStorage()) {
+        releaseStorage();
+    }
+    data_ = data;
+    capacity_ = capacity;
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = readerIndex_ + readable;
+}
+
+void Buffer::shrink() {
+    size_t readable = readableBytes();
+    if (readable == 0 && pool_) {
+        retrieveAll();
+        return;
+    }
+    // 大块内存只剩少量数据时才换，避免来回申请
+    size_t size = kCheapPrepend + std::max(readable, kInitialSize);
+    if (capacity_ > kExtraBufSize && capacity_ >= 4 * size) {
+        reallocate(size);
+    }
+}
+
 /*
  * 从fd中读取数据， Poller工作在LT模式
  * Buffer缓冲区有大小，但是从fd读取数据，不知道最终的大小
 */
 ssize_t Buffer::readFd(int fd, int* saveErrno) {
-    char extrabuf[65536];
+    ensureStorage();
+    char extrabuf[kExtraBufSize];
     struct iovec vec[2];
     const size_t writable = writableBytes();
     vec[0].iov_base = begin() + writerIndex_;
@@ -25,9 +131,13 @@ ssize_t Buffer::readFd(int fd, int* saveErrno) {
         writerIndex_ += n;
     } else {
         // extrabuf里面也写入了数据
-        writerIndex_ = buffer_.size();
+        writerIndex_ = capacity_;
         append(extrabuf, n - writable);
     }
+    if (n <= 0 && pool_ && readableBytes() == 0) {
+        // 没有读到数据(EAGAIN或者对端关闭)，不再占用借来的内存
+        retrieveAll();
+    }
     return n;
 }
 
@@ -38,4 +148,4 @@ ssize_t Buffer::writeFd(int fd, int* saveErrno) {
         *saveErrno = errno;
     }
     return n;
-}
\ No newline at end of file
+}
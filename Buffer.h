@@ -6,32 +6,59 @@
 
 #include "nocopyable.h"
 
+class BufferPool;
+
+/**
+ * 内存直接通过malloc管理，不再使用vector，扩容时只拷贝可读的数据
+ * 指定了BufferPool的缓冲区在写入数据时才从pool借内存，数据被取完之后马上还回去，
+ * 空闲的连接不占用缓冲区内存；没有pool的缓冲区和原来一样，构造时分配，只扩容不释放
+ */
 class Buffer {
 public:
     static const size_t kCheapPrepend = 8;
     static const size_t kInitialSize = 1024;
-
-    explicit Buffer(size_t initialSize = kInitialSize)
-        : buffer_(kCheapPrepend + initialSize), readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend) {}
+    // readFd使用的栈上临时缓冲区大小
+    static const size_t kExtraBufSize = 65536;
+
+    explicit Buffer(size_t initialSize = kInitialSize);
+    // 从pool借内存的缓冲区，pool只能在所属的loop线程中使用
+    explicit Buffer(BufferPool *pool);
+    ~Buffer();
+
+    // 拷贝和移动得到的缓冲区都不使用pool
+    Buffer(const Buffer &rhs);
+    Buffer(Buffer &&rhs);
+    Buffer &operator=(Buffer rhs) {
+        swap(rhs);
+        return *this;
+    }
 
     size_t readableBytes() const { return writerIndex_ - readerIndex_; }
-    size_t writableBytes() const { return buffer_.size() - writerIndex_; }
+    size_t writableBytes() const { return capacity_ - writerIndex_; }
     size_t prependableBytes() const { return readerIndex_; }
+    // 当前占用的内存大小
+    size_t capacity() const { return hasStorage() ? capacity_ : 0; }
 
-    // 返回缓冲区中可读数据的起始地址
+    // 返回缓冲区中可读数据的起始地址，写入、retrieve和shrink之后可能失效
     const char* peek() const { return begin() + readerIndex_; }
 
+    // 取走len字节，取完全部数据时和retrieveAll一样
     void retrieve(size_t len) {
         if (len < readableBytes()) {
             // 应用制度去了可读缓冲区len长度
-            readerIndex_ += len; 
+            readerIndex_ += len;
         } else {
             retrieveAll();
         }
     }
 
-    void retrieveAll() { 
+    // 使用pool的缓冲区取完数据时马上把内存还给pool，之前peek()得到的指针随即失效
+    // 需要先取走再使用的数据用retrieveAsString拷贝出来
+    void retrieveAll() {
         readerIndex_ = writerIndex_ = kCheapPrepend;
+        if (pool_ && hasStorage()) {
+            releaseStorage();
+        }
     }
 
     std::string retrieveAllAsString() {
@@ -50,6 +77,19 @@ public:
         }
     }
 
+    // 还没有内存时先借一块，保证有可写空间，readFd之前会自动调用
+    void ensureStorage() {
+        if (!hasStorage()) {
+            makeSpace(kInitialSize);
+        }
+    }
+
+    // 数据远小于占用的内存时换一块合适大小的内存，没有数据时还给pool
+    void shrink();
+
+    // 切换借还内存的pool，nullptr表示之后直接使用malloc/free，已经借到的内存不受影响
+    void setPool(BufferPool *pool) { pool_ = pool; }
+
     // [data, data + len]内存中的数据添加到writeable缓冲区中
     void append(const char *data, size_t len) {
         ensureWritableBytes(len);
@@ -57,6 +97,14 @@ public:
         writerIndex_ += len;
     }
 
+    // 交换两个缓冲区的数据，不需要拷贝，各自的pool不变
+    void swap(Buffer &rhs) {
+        std::swap(data_, rhs.data_);
+        std::swap(capacity_, rhs.capacity_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+    }
+
     char* beginWrite() {
         return begin() + writerIndex_;
     }
@@ -71,22 +119,22 @@ public:
     ssize_t writeFd(int fd, int* saveErrno);
 
 private:
-    char* begin() { return &*buffer_.begin(); }
-    const char* begin() const { return &*buffer_.begin(); }
+    // 没有内存时data_指向这块共享的只读空间，peek()等仍然返回有效的地址
+    static char emptyStorage_[kCheapPrepend];
 
-    void makeSpace(size_t len) {
-        if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
-            buffer_.resize(writerIndex_ + len);
-        } else {
-            size_t readable = readableBytes();
-            std::copy(begin() + readerIndex_, 
-                      begin() + writerIndex_,
-                      begin() + kCheapPrepend);
-            readerIndex_ = kCheapPrepend;
-            writerIndex_ = readerIndex_ + readable;
-        }
-    }
-    std::vector<char> buffer_;
+    char* begin() { return data_; }
+    const char* begin() const { return data_; }
+    bool hasStorage() const { return data_ != emptyStorage_; }
+
+    void makeSpace(size_t len);
+    // 把可读数据搬到一块能容纳size字节的新内存中
+    void reallocate(size_t size);
+    char *allocate(size_t size, size_t *capacity);
+    void releaseStorage();
+
+    char *data_;
+    size_t capacity_;
     size_t readerIndex_;
     size_t writerIndex_;
-};
\ No newline at end of file
+    BufferPool *pool_;
+};
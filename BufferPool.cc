@@ -0,0 +1,121 @@
+#include "BufferPool.h"
+
+#include <stdlib.h>
+
+#include "EventLoop.h"
+#include "Logger.h"
+#include "RelaxedCounter.h"
+
+namespace {
+
+const size_t kPageSize = 4096;
+
+char *allocChunk(size_t size) {
+    char *chunk = static_cast<char *>(::malloc(size));
+    if (chunk == nullptr) {
+        LOG_FATAL("BufferPool::malloc %zu bytes failed\n", size);
+    }
+    return chunk;
+}
+
+}  // namespace
+
+const size_t BufferPool::kMinChunkSize;
+const size_t BufferPool::kMaxChunkSize;
+const size_t BufferPool::kDefaultMaxCachedBytes;
+
+BufferPool::BufferPool(EventLoop *loop, size_t maxCachedBytes)
+    : loop_(loop), maxCachedBytes_(maxCachedBytes)
+    , hits_(0), misses_(0), releases_(0), drops_(0), cachedBytes_(0) {
+    for (int i = 0; i < kNumClasses; ++i) {
+        freeLists_[i] = nullptr;
+    }
+}
+
+BufferPool::~BufferPool() {
+    trim();
+}
+
+size_t BufferPool::chunkSizeFor(size_t size) {
+    if (size > kMaxChunkSize) {
+        return (size + kPageSize - 1) & ~(kPageSize - 1);
+    }
+    size_t chunkSize = kMinChunkSize;
+    while (chunkSize < size) {
+        chunkSize <<= 1;
+    }
+    return chunkSize;
+}
+
+int BufferPool::classIndex(size_t chunkSize) {
+    if (chunkSize < kMinChunkSize || chunkSize > kMaxChunkSize || (chunkSize & (chunkSize - 1)) != 0) {
+        return -1;
+    }
+    return __builtin_ctzl(chunkSize) - __builtin_ctzl(kMinChunkSize);
+}
+
+bool BufferPool::inOwnerThread() const {
+    return loop_->isInLoopThread();
+}
+
+char *BufferPool::acquire(size_t size, size_t *capacity) {
+    size_t chunkSize = chunkSizeFor(size);
+    *capacity = chunkSize;
+    if (!inOwnerThread()) {
+        return allocChunk(chunkSize);
+    }
+
+    int index = classIndex(chunkSize);
+    if (index >= 0 && freeLists_[index]) {
+        FreeChunk *chunk = freeLists_[index];
+        freeLists_[index] = chunk->next;
+        addRelaxed(hits_, 1);
+        cachedBytes_.store(cachedBytes_.load(std::memory_order_relaxed) - chunkSize, std::memory_order_relaxed);
+        return reinterpret_cast<char *>(chunk);
+    }
+    addRelaxed(misses_, 1);
+    return allocChunk(chunkSize);
+}
+
+void BufferPool::release(char *chunk, size_t capacity) {
+    if (!inOwnerThread()) {
+        ::free(chunk);
+        return;
+    }
+
+    int index = classIndex(capacity);
+    size_t cached = cachedBytes_.load(std::memory_order_relaxed);
+    if (index < 0 || cached + capacity > maxCachedBytes_) {
+        addRelaxed(drops_, 1);
+        ::free(chunk);
+        return;
+    }
+    FreeChunk *node = reinterpret_cast<FreeChunk *>(chunk);
+    node->next = freeLists_[index];
+    freeLists_[index] = node;
+    addRelaxed(releases_, 1);
+    cachedBytes_.store(cached + capacity, std::memory_order_relaxed);
+}
+
+void BufferPool::trim() {
+    for (int i = 0; i < kNumClasses; ++i) {
+        FreeChunk *chunk = freeLists_[i];
+        while (chunk) {
+            FreeChunk *next = chunk->next;
+            ::free(chunk);
+            chunk = next;
+        }
+        freeLists_[i] = nullptr;
+    }
+    cachedBytes_.store(0, std::memory_order_relaxed);
+}
+
+BufferPool::Stats BufferPool::stats() const {
+    Stats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    stats.releases = releases_.load(std::memory_order_relaxed);
+    stats.drops = drops_.load(std::memory_order_relaxed);
+    stats.cachedBytes = cachedBytes_.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "nocopyable.h"
+
+class EventLoop;
+
+/**
+ * 每个EventLoop一个的缓冲区内存池，按2的幂分成若干个大小等级，每个等级一个空闲链表
+ * 连接的Buffer在有数据时借一块内存，数据处理完之后马上还回来，内存占用跟着实际在途的数据走
+ * 只在所属loop线程中借还，不需要加锁；在其他线程中借还时直接使用malloc/free
+ * 超过kMaxChunkSize的大块内存不缓存，缓存的总量超过上限时直接释放
+ */
+class BufferPool : nocopyable {
+public:
+    static const size_t kMinChunkSize = 1024;
+    static const size_t kMaxChunkSize = 4 * 1024 * 1024;
+    static const size_t kDefaultMaxCachedBytes = 16 * 1024 * 1024;
+
+    // 统计信息，可以在其他线程中读取，都是近似值
+    struct Stats {
+        uint64_t hits;         // 从空闲链表中借到的次数
+        uint64_t misses;       // 需要向malloc申请的次数
+        uint64_t releases;     // 归还到空闲链表中的次数
+        uint64_t drops;        // 超过缓存上限或者太大，直接释放的次数
+        size_t cachedBytes;    // 空闲链表中的字节数
+    };
+
+    explicit BufferPool(EventLoop *loop, size_t maxCachedBytes = kDefaultMaxCachedBytes);
+    ~BufferPool();
+
+    // 借一块至少size字节的内存，实际的大小写入capacity
+    char *acquire(size_t size, size_t *capacity);
+    // 归还acquire或者malloc得到的内存，capacity是它的实际大小
+    void release(char *chunk, size_t capacity);
+    // 释放所有缓存的内存，loop空闲时调用
+    void trim();
+
+    void setMaxCachedBytes(size_t bytes) { maxCachedBytes_ = bytes; }
+    Stats stats() const;
+
+    // size向上取到所在的大小等级，超过kMaxChunkSize时按页对齐
+    static size_t chunkSizeFor(size_t size);
+
+private:
+    // 空闲的内存块，链表指针直接存放在块的开头
+    struct FreeChunk {
+        FreeChunk *next;
+    };
+
+    // 1K, 2K, ... , 4M
+    static const int kNumClasses = 13;
+
+    static int classIndex(size_t chunkSize);
+    bool inOwnerThread() const;
+
+    EventLoop *loop_;
+    size_t maxCachedBytes_;
+    FreeChunk *freeLists_[kNumClasses];
+
+    // 只由所属的loop线程修改
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> releases_;
+    std::atomic<uint64_t> drops_;
+    std::atomic<size_t> cachedBytes_;
+};
@@ -13,4 +13,19 @@ using CloseCallback = std::function<void(const TCPConnectionPtr&)>;
 using WriteCompleteCallback = std::function<void(const TCPConnectionPtr&)>;
 using HighWaterMarkCallback = std::function<void(TCPConnectionPtr&, size_t)>;
 
-using MessageCallback = std::function<void(const TCPConnectionPtr&, Buffer*, Timestamp)>;
\ No newline at end of file
+using TimerCallback = std::function<void()>;
+
+using MessageCallback = std::function<void(const TCPConnectionPtr&, Buffer*, Timestamp)>;
+// 流式发送时向Buffer中填充下一块数据，返回false表示这是最后一块
+using StreamProducer = std::function<bool(const TCPConnectionPtr&, Buffer*)>;
+
+// 连接的用户回调，同一个server的所有连接共享一份，不需要每个连接拷贝一次
+// 共享之后不再修改，修改时先拷贝一份新的(写时复制)
+struct ConnectionCallbacks {
+    ConnectionCallback connection;
+    MessageCallback message;
+    WriteCompleteCallback writeComplete;
+    HighWaterMarkCallback highWaterMark;
+    CloseCallback close;
+};
+using ConnectionCallbacksPtr = std::shared_ptr<const ConnectionCallbacks>;
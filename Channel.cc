@@ -12,6 +12,9 @@ Channel::Channel(EventLoop *loop, int fd)
 }
 
 Channel::~Channel() {
+    if (dirtyIndex_ >= 0) {
+        loop_->discardChannelUpdate(this);
+    }
 }
 
 // channel的tie什么时候被调用
@@ -25,15 +28,37 @@ void Channel::tie(const std::shared_ptr<void> &obj) {
  * EventLoop => ChanelList Poller
  */
 void Channel::update() {
-    // 通过Channel所属的EventLoop，调用Poller的相应方法，注册fd的events事件
+    if (dirtyIndex_ < 0 && pollEvents() == registeredEvents_) {
+        return;  // 注册的事件没有变化，比如边缘触发模式下开关写事件
+    }
+    // 通过Channel所属的EventLoop，在下一次poll之前调用Poller的相应方法，注册fd的events事件
     loop_->updateChannel(this);
 }
 
-// 在Channel中所属的EventLoop，把当前的Channel删除
+// 在Channel中所属的EventLoop，把当前的Channel删除，立即生效
 void Channel::remove() {
+    registeredEvents_ = kNoneEvent;
     loop_->removeChannel(this);
 }
 
+int Channel::pollEvents() const {
+    if (events_ == kNoneEvent) {
+        return kNoneEvent;
+    }
+    int events = events_;
+    if (edgeTriggered_) {
+        events |= kWriteEvent | EPOLLET;
+        if (events_ & kReadEvent) {
+            events |= EPOLLRDHUP;
+        }
+    }
+    if (exclusive_) {
+        // EPOLLEXCLUSIVE不能和EPOLLPRI一起使用，否则epoll_ctl返回EINVAL
+        events = (events & ~EPOLLPRI) | EPOLLEXCLUSIVE;
+    }
+    return events;
+}
+
 void Channel::handleEvent(Timestamp receiveTime) {
     if (tied_) {
         std::shared_ptr<void> guard = tie_.lock();
@@ -47,7 +72,7 @@ void Channel::handleEvent(Timestamp receiveTime) {
 
 // 根据Poller通知的Channel发生的具体事件，由Channel负责调用具体的回调操作
 void Channel::handleEventWithGuard(Timestamp receiveTime) {
-    LOG_INFO("Channel::handleEvent revents:%d\n", revents_);
+    LOG_DEBUG("Channel::handleEvent revents:%d\n", revents_);
 
     if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN)) {
         if (closeCallback_) {
@@ -61,13 +86,14 @@ void Channel::handleEventWithGuard(Timestamp receiveTime) {
         }
     }
 
-    if (revents_ & (EPOLLIN | EPOLLPRI)) {
+    if (revents_ & (EPOLLIN | EPOLLPRI | EPOLLRDHUP)) {
         if (readCallback_) {
             readCallback_(receiveTime);
         }
     }
 
-    if (revents_ & EPOLLOUT) {
+    // 边缘触发模式下没有数据要发送时也会收到EPOLLOUT
+    if ((revents_ & EPOLLOUT) && (events_ & kWriteEvent)) {
         if (writeCallback_) {
             writeCallback_();
         }
@@ -3,6 +3,7 @@
 #include <functional>
 #include <memory>
 
+#include "InlineFunction.h"
 #include "Timestamp.h"
 #include "nocopyable.h"
 
@@ -14,8 +15,9 @@ class EventLoop;
  */
 class Channel : nocopyable {
 public:
-    using EventCallback = std::function<void()>;
-    using ReadEventCallback = std::function<void(Timestamp)>;
+    // 回调一般是std::bind(成员函数, this, ...)，放在内联存储中，不需要分配内存
+    using EventCallback = InlineFunction<void()>;
+    using ReadEventCallback = InlineFunction<void(Timestamp)>;
 
     Channel(EventLoop *loop, int fd);
     ~Channel();
@@ -34,7 +36,11 @@ public:
 
     int fd() const { return fd_; }
     int events() const { return events_; }
+    // 实际注册到poller的事件，边缘触发模式下EPOLLOUT一直注册
+    int pollEvents() const;
     void set_revents(int events) { revents_ = events; }
+    // 最近一次poll返回的事件
+    int revents() const { return revents_; }
 
     // 设置fd相应的事件
     void enableReading() {
@@ -58,15 +64,28 @@ public:
         update();
     }
 
+    // 边缘触发模式，需要在注册事件之前设置
+    // 读事件需要一直读到EAGAIN，开关写事件只修改events_，不需要epoll_ctl
+    // 同时注册EPOLLRDHUP，对端关闭写端时即使FIN和数据在同一次事件中到达，读者也知道要读到EOF
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+    bool isEdgeTriggered() const { return edgeTriggered_; }
+    // 多个loop监听同一个fd时只唤醒其中一个(EPOLLEXCLUSIVE)，需要在注册事件之前设置
+    void setExclusive(bool on) { exclusive_ = on; }
+
     // 返回fd当前事件状态
     bool isNoneEvent() const { return events_ == kNoneEvent; }
     bool isWriting() const { return events_ & kWriteEvent; }
     bool isReading() const { return events_ & kReadEvent; }
 
-    int index() { return index_; }
-    void set_index(int idx) { index_ = idx; }
+    // 事件变化之后不立即通知poller，由EventLoop在下一次poll之前统一提交
+    int dirtyIndex() const { return dirtyIndex_; }
+    void set_dirtyIndex(int idx) { dirtyIndex_ = idx; }
+    int registeredEvents() const { return registeredEvents_; }
+    void set_registeredEvents(int events) { registeredEvents_ = events; }
 
     EventLoop *ownerLoop() { return loop_; }
+    // 连接迁移时换到另一个loop，只能在原loop中remove之后调用，之后的事件注册都交给新的loop
+    void setOwnerLoop(EventLoop *loop) { loop_ = loop; }
     void remove();
 
 private:
@@ -81,7 +100,10 @@ private:
     const int fd_;     // fd, Poller监听的对象
     int events_{0};    // 注册fd感兴趣的事件
     int revents_{0};   // Poller返回具体发生的事件
-    int index_{-1};    // used by Poller.
+    bool edgeTriggered_{false};
+    bool exclusive_{false};
+    int registeredEvents_{0};  // 上一次通知poller的事件
+    int dirtyIndex_{-1};       // 在loop脏列表中的下标，-1表示没有待提交的变化
 
     std::weak_ptr<void> tie_;
     bool tied_{false};
@@ -2,11 +2,29 @@
 
 #include "Poller.h"
 #include "EPollPoller.h"
+#include "IoUringPoller.h"
+#include "Logger.h"
 
 Poller* Poller::newDefaultPoller(EventLoop* loop) {
-    if (::getenv("LITENET_USE_POLL")) {
-        return nullptr;  // 生成poll的实例
+    if (::getenv("LITENET_USE_IOURING")) {
+        return newPoller(loop, EventLoop::kIoUringBackend);
     } else {
         return new EPollPoller(loop);  // 生成epoll的实例
     }
-}
\ No newline at end of file
+}
+
+Poller* Poller::newPoller(EventLoop* loop, EventLoop::Backend backend) {
+    if (backend == EventLoop::kIoUringBackend) {
+        Poller *poller = IoUringPoller::create(loop);
+        if (poller != nullptr) {
+            return poller;
+        }
+        // 内核不支持io_uring，回退到epoll
+        LOG_INFO("io_uring unavailable, fall back to epoll");
+        return new EPollPoller(loop);
+    } else if (backend == EventLoop::kEPollBackend) {
+        return new EPollPoller(loop);
+    } else {
+        return newDefaultPoller(loop);
+    }
+}
@@ -5,8 +5,7 @@
 #include <unistd.h>
 #include <cassert>
 
-// channel未添加到Poller中
-const int kNew = -1;  // channel的成员index_ = -1
+// channel的注册状态保存在channels_表项中，不在表中即为未添加
 // channel已添加到Poller中
 const int kAdded = 1;
 // channel从Poller中删除
@@ -24,7 +23,7 @@ EPollPoller::~EPollPoller() {
 }
 
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList &activeChannels) {
-    LOG_INFO("EPollPoller::%s() => fd total count:%lu\n", __FUNCTION__, channels_.size());
+    LOG_DEBUG("EPollPoller::%s() => fd total count:%lu\n", __FUNCTION__, channels_.size());
     
     int numEvents = ::epoll_wait(epollfd_, events_.data(), static_cast<int>(events_.size()), timeoutMs);
     int saveErrno = errno;
@@ -32,7 +31,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList &activeChannels) {
     Timestamp now(Timestamp::now());
     
     if (numEvents > 0) {
-        LOG_INFO("EPollPoller::poll() %d events happened \n", numEvents);
+        LOG_DEBUG("EPollPoller::poll() %d events happened \n", numEvents);
         fillActiveChannels(numEvents, activeChannels);
         if (numEvents == events_.size()) {
             events_.resize(events_.size() * 2);
@@ -49,22 +48,25 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList &activeChannels) {
 }
 
 void EPollPoller::updateChannel(Channel *channel) {
-    const int index = channel->index();
-    LOG_INFO("EPollPoller::%s => fd=%d events=%d index=%d \n", __FUNCTION__, channel->fd(), channel->events(), index);
+    int fd = channel->fd();
+    ChannelTable::Entry *entry = channels_.find(fd);
+    LOG_DEBUG("EPollPoller::%s => fd=%d events=%d state=%d \n", __FUNCTION__, fd, channel->events(), entry ? entry->state : 0);
 
-    if (index == kNew || index == kDeleted) {
-        if (index == kNew) {
-            int fd = channel->fd();
-            channels_[fd] = channel;
+    if (entry == nullptr || entry->state == kDeleted) {
+        if (entry == nullptr) {
+            entry = &channels_.insert(fd, channel);
         }
-        channel->set_index(kAdded);
+        entry->state = kAdded;
         update(EPOLL_CTL_ADD, channel);
     } else {
         // channel已经在Poller上注册过了
-        int fd = channel->fd();
         if (channel->isNoneEvent()) {
             update(EPOLL_CTL_DEL, channel);
-            channel->set_index(kDeleted);
+            entry->state = kDeleted;
+        } else if (channel->pollEvents() & EPOLLEXCLUSIVE) {
+            // EPOLLEXCLUSIVE只能和EPOLL_CTL_ADD一起使用，MOD会返回EINVAL
+            update(EPOLL_CTL_DEL, channel);
+            update(EPOLL_CTL_ADD, channel);
         } else {
             update(EPOLL_CTL_MOD, channel);
         }
@@ -73,15 +75,13 @@ void EPollPoller::updateChannel(Channel *channel) {
 
 void EPollPoller::removeChannel(Channel *channel) {
     int fd = channel->fd();
-    channels_.erase(fd);
+    LOG_INFO("EPollPoller::%s => fd=%d \n", __FUNCTION__, fd);
 
-    LOG_INFO("EPollPoller::%s => fd=%d \n", __FUNCTION__, channel->fd());
-
-    int index = channel->index();
-    if (index == kAdded) {
+    ChannelTable::Entry *entry = channels_.find(fd);
+    if (entry != nullptr && entry->state == kAdded) {
         update(EPOLL_CTL_DEL, channel);
     }
-    channel->set_index(kNew);
+    channels_.erase(fd);
 }
 
 // 填写活跃的连接
@@ -98,13 +98,13 @@ void EPollPoller::fillActiveChannels(int numEvents, ChannelList &activeChannels)
 
 // 更新Channel通道
 void EPollPoller::update(int operation, Channel *channel) {
-    LOG_INFO("EPoller::update() chennel");
+    LOG_DEBUG("EPoller::update() chennel");
     epoll_event event;
     memset(&event, 0, sizeof(event));
 
     int fd = channel->fd();
 
-    event.events = channel->events();
+    event.events = channel->pollEvents();
     event.data.fd = fd;
     event.data.ptr = channel;
 
@@ -112,7 +112,7 @@ void EPollPoller::update(int operation, Channel *channel) {
         if (operation == EPOLL_CTL_DEL) {
             LOG_ERROR("EPollPoller::epoll_ctr del error:%d\n", errno);
         } else {
-            LOG_FATAL("EPollPoller::epoll_ctl add/mod/del error:%d\n", errno)
+            LOG_FATAL("EPollPoller::epoll_ctl add/mod/del error:%d\n", errno);
         }
     }
 }
@@ -1,6 +1,10 @@
 #include "EventLoop.h"
+#include "BufferPool.h"
 #include "Logger.h"
 #include "Poller.h"
+#include "Slab.h"
+#include "TimerQueue.h"
+#include "TimingWheel.h"
 
 #include <stdlib.h>
 #include <unistd.h>
@@ -14,24 +18,52 @@ __thread EventLoop *t_loopInThisThread = nullptr;
 // 默认Poller IO复用接口超时时间
 const int kPollTimeMs = 100000;
 
+// 每个loop最多缓存的空闲回调节点个数
+const int kMaxFreeFunctors = 1024;
+
+namespace {
+
+// 每个线程缓存的回调节点，生产者优先从这里获取节点
+template <typename Node>
+struct NodeCache {
+    Node *head = nullptr;
+
+    ~NodeCache() {
+        while (head) {
+            Node *next = head->next;
+            delete head;
+            head = next;
+        }
+    }
+};
+
+}  // namespace
+
 // 创建wakeupfd，通过notify唤醒subReactor处理新来的Channel
 int createEventfd() {
     int evtfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
     if (evtfd < 0) {
-        LOG_FATAL("EventLoop::eventfd error:%d\n", error);
+        LOG_FATAL("EventLoop::eventfd error:%d\n", errno);
     }
     return evtfd;
 }
 
-EventLoop::EventLoop() 
+EventLoop::EventLoop(Backend backend) 
     : looping_(false)
     , quit_(false)
-    , callingPendingFunctors_(false)
     , threadId_(CurrentThread::tid())
-    , poller_(Poller::newDefaultPoller(this))
+    , bufferPool_(new BufferPool(this))
+    , connectionSlab_(std::make_shared<Slab>())
+    , poller_(Poller::newPoller(this, backend))
+    , timerQueue_(new TimerQueue(this))
     , wakeupFd_(createEventfd())
     , wakeupChannel_(new Channel(this, wakeupFd_))
-    , currentActiveChannel_(nullptr) {
+    , currentActiveChannel_(nullptr)
+    , callingPendingFunctors_(false)
+    , freeFunctors_(nullptr)
+    , numFreeFunctors_(0)
+    , numConnections_(0)
+    , pendingBytes_(0) {
 
     LOG_DEBUG("EventLoop::EventLoop created %p in thread %d\n", this, threadId_);
     if (t_loopInThisThread) {
@@ -47,6 +79,20 @@ EventLoop::EventLoop()
 }
 
 EventLoop::~EventLoop() {
+    // 释放还没有执行的回调
+    PendingFunctor *node = pendingFunctors_.popAll();
+    while (node) {
+        PendingFunctor *next = node->next;
+        delete node;
+        node = next;
+    }
+    node = freeFunctors_.exchange(nullptr);
+    while (node) {
+        PendingFunctor *next = node->next;
+        delete node;
+        node = next;
+    }
+
     wakeupChannel_->disableAll();
     wakeupChannel_->remove();
     ::close(wakeupFd_);
@@ -61,8 +107,13 @@ void EventLoop::loop() {
 
     while (!quit_) {
         activeChannels_.clear();
+        flushDirtyChannels();
         // 监听client的fd以及wakeupFD
         pollReturnTime_ = poller_->poll(kPollTimeMs, activeChannels_);
+        if (activeChannels_.empty()) {
+            // 整个poll超时时间内都没有事件，loop空闲，把缓存的缓冲区内存还给系统
+            bufferPool_->trim();
+        }
         for (Channel *channel : activeChannels_) {
             // Poller监听哪些Channel发送事件了，然后上报给EventLoop，通知Channel处理相应的事件
             channel->handleEvent(pollReturnTime_);
@@ -100,14 +151,14 @@ void EventLoop::runInLoop(Functor cb) {
 
 // 把cb放入队列中，唤醒loop所在线程，执行cb
 void EventLoop::queueInLoop(Functor cb) {
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        pendingFunctors_.emplace_back(cb);
-    }
+    PendingFunctor *node = allocPendingFunctor();
+    node->functor = std::move(cb);
+    bool wasEmpty = pendingFunctors_.push(node);
 
     // 唤醒相应的，需要执行上面回调操作的loop的线程
     // callingPendingFunctors_为true表示当前loop正在执行回调，但是loop又有了新的回调
-    if (!isInLoopThread() || callingPendingFunctors_) {
+    // 只有队列被取空之后的第一个生产者需要唤醒，之后的生产者知道loop已经被唤醒或者正醒着
+    if (wasEmpty && (!isInLoopThread() || callingPendingFunctors_)) {
         // 唤醒loop所在线程
         wakeup(); 
     }
@@ -119,18 +170,71 @@ void EventLoop::wakeup() {
     uint64_t one = 1;
     ssize_t n = ::write(wakeupFd_, &one, sizeof(one));
     if (n != sizeof(one)) {
-        LOG_ERROR("EvnetLoop::wakeup() writes %lu bytes instead of 8\n", n);
+        LOG_ERROR("EvnetLoop::wakeup() writes %ld bytes instead of 8\n", n);
+    }
+}
+
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb) {
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb) {
+    Timestamp time(addTime(Timestamp::now(), delay));
+    return runAt(time, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb) {
+    Timestamp time(addTime(Timestamp::now(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId) {
+    timerQueue_->cancel(timerId);
+}
+
+TimingWheel *EventLoop::timingWheel() {
+    if (!timingWheel_) {
+        timingWheel_.reset(new TimingWheel(this));
     }
+    return timingWheel_.get();
 }
 
 void EventLoop::updateChannel(Channel *channel) {
-    poller_->updateChannel(channel);
+    if (channel->dirtyIndex() < 0) {
+        channel->set_dirtyIndex(static_cast<int>(dirtyChannels_.size()));
+        dirtyChannels_.push_back(channel);
+    }
 }
 
 void EventLoop::removeChannel(Channel *channel) {
+    discardChannelUpdate(channel);
     poller_->removeChannel(channel);
 }
 
+void EventLoop::discardChannelUpdate(Channel *channel) {
+    int idx = channel->dirtyIndex();
+    if (idx >= 0) {
+        // 和最后一个交换之后删除，O(1)
+        Channel *last = dirtyChannels_.back();
+        dirtyChannels_[idx] = last;
+        last->set_dirtyIndex(idx);
+        dirtyChannels_.pop_back();
+        channel->set_dirtyIndex(-1);
+    }
+}
+
+void EventLoop::flushDirtyChannels() {
+    for (Channel *channel : dirtyChannels_) {
+        channel->set_dirtyIndex(-1);
+        int events = channel->pollEvents();
+        if (events != channel->registeredEvents()) {
+            channel->set_registeredEvents(events);
+            poller_->updateChannel(channel);
+        }
+    }
+    dirtyChannels_.clear();
+}
+
 bool EventLoop::hasChannel(Channel *channel) {
     return poller_->hasChannel(channel);
 }
@@ -145,16 +249,58 @@ void EventLoop::handleRead() {
 
 // 执行回调
 void EventLoop::doPendingFunctors() {
-    std::vector<Functor> functors;
     callingPendingFunctors_ = true;
 
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        functors.swap(pendingFunctors_);
+    // 一次取走所有回调，执行期间新加入的回调留到下一轮
+    PendingFunctor *first = pendingFunctors_.popAll();
+    PendingFunctor *last = nullptr;
+    int count = 0;
+    for (PendingFunctor *node = first; node != nullptr; node = node->next) {
+        node->functor(); // 执行当前loop需要执行的回调操作
+        node->functor = nullptr;  // 及时释放回调持有的资源，比如TCPConnectionPtr
+        last = node;
+        ++count;
     }
-
-    for (const Functor& functor : functors) {
-        functor(); // 执行当前loop需要执行的回调操作
+    if (first) {
+        recyclePendingFunctors(first, last, count);
     }
     callingPendingFunctors_ = false;
+}
+
+EventLoop::PendingFunctor *EventLoop::allocPendingFunctor() {
+    static thread_local NodeCache<PendingFunctor> cache;
+    if (cache.head == nullptr) {
+        // 本线程缓存的节点用完了，一次取走当前loop回收的所有节点
+        // 只有整体exchange，不会出现无锁栈单个pop的ABA问题
+        cache.head = freeFunctors_.exchange(nullptr, std::memory_order_acquire);
+        numFreeFunctors_.store(0, std::memory_order_relaxed);
+    }
+
+    PendingFunctor *node = cache.head;
+    if (node) {
+        cache.head = node->next;
+        node->next = nullptr;
+        return node;
+    }
+    return new PendingFunctor();
+}
+
+// 执行完的节点整体挂回freeFunctors_，只有loop线程会push
+void EventLoop::recyclePendingFunctors(PendingFunctor *first, PendingFunctor *last, int count) {
+    if (numFreeFunctors_.load(std::memory_order_relaxed) + count > kMaxFreeFunctors) {
+        while (first) {
+            PendingFunctor *next = first->next;
+            delete first;
+            first = next;
+        }
+        return;
+    }
+
+    numFreeFunctors_.fetch_add(count, std::memory_order_relaxed);
+    PendingFunctor *head = freeFunctors_.load(std::memory_order_relaxed);
+    do {
+        last->next = head;
+    } while (!freeFunctors_.compare_exchange_weak(head, first,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed));
 }
\ No newline at end of file
@@ -3,23 +3,37 @@
 #include <atomic>
 #include <functional>
 #include <memory>
-#include <mutex>
 #include <thread>
 #include <vector>
 
+#include "Callbacks.h"
 #include "CurrentThread.h"
+#include "InlineFunction.h"
+#include "MpscQueue.h"
+#include "TimerId.h"
 #include "Timestamp.h"
 
+class BufferPool;
 class Channel;
 class Poller;
+class Slab;
 class TimerQueue;
+class TimingWheel;
 
 // 事件循环类，主要包含两个模块 Channel Poller(epoll的抽象)
 class EventLoop {
 public:
-    using Functor = std::function<void()>;
+    // 带内联存储的回调，常见的std::bind(成员函数, TCPConnectionPtr, ...)不会分配内存
+    using Functor = InlineFunction<void(), 80>;
 
-    EventLoop();
+    // IO复用的实现，kDefaultBackend由环境变量决定
+    enum Backend {
+        kDefaultBackend,
+        kEPollBackend,
+        kIoUringBackend
+    };
+
+    explicit EventLoop(Backend backend = kDefaultBackend);
     ~EventLoop();
 
     // 开启事件循环
@@ -37,26 +51,71 @@ public:
     // 唤醒loop所在线程
     void wakeup();
 
+    // 定时器，均为线程安全，在loop线程中调用时不会产生线程切换
+    // 在time时刻执行cb
+    TimerId runAt(Timestamp time, TimerCallback cb);
+    // delay秒之后执行cb
+    TimerId runAfter(double delay, TimerCallback cb);
+    // 每隔interval秒执行一次cb
+    TimerId runEvery(double interval, TimerCallback cb);
+    // 取消定时器
+    void cancel(TimerId timerId);
+
+    // loop的时间轮，用于管理连接的空闲超时，第一次使用时创建，只能在loop线程中调用
+    TimingWheel *timingWheel();
+    // loop的缓冲区内存池，连接的接收缓冲区从这里借内存，只能在loop线程中借还，统计信息可以在其他线程中读取
+    BufferPool *bufferPool() const { return bufferPool_.get(); }
+    // 分配这个loop的连接对象的slab，线程安全，连接释放之前slab不会被销毁
+    const std::shared_ptr<Slab> &connectionSlab() const { return connectionSlab_; }
+
     // EventLoop的方法 => Poller的方法
+    // updateChannel只记录channel的变化，在下一次poll之前统一提交，同一轮中来回开关的事件相互抵消
     void updateChannel(Channel *channel);
     void removeChannel(Channel *channel);
+    // 丢弃channel还没有提交的变化
+    void discardChannelUpdate(Channel *channel);
     bool hasChannel(Channel *channel);
 
     // 判断EventLoop对象是否在自己的线程中
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 
+    // 负载计数，由连接维护，供LoopSelector在其他线程中读取，都是近似值
+    // 属于这个loop的连接数，创建连接时就计入，连续接受的连接可以马上看到
+    int numConnections() const { return numConnections_.load(std::memory_order_relaxed); }
+    // 所有连接发送队列中积压的字节数
+    int64_t pendingBytes() const { return pendingBytes_.load(std::memory_order_relaxed); }
+    void addConnections(int delta) { numConnections_.fetch_add(delta, std::memory_order_relaxed); }
+    void addPendingBytes(int64_t delta) { pendingBytes_.fetch_add(delta, std::memory_order_relaxed); }
+
 private:
     void handleRead();         // wake up
+    void flushDirtyChannels(); // 把这一轮事件有变化的channel提交给poller
     void doPendingFunctors();  // 执行回调
 
     using ChannelList = std::vector<Channel *>;
 
+    // 等待执行的回调，作为无锁队列的节点，执行完之后回收复用
+    struct PendingFunctor {
+        Functor functor;
+        PendingFunctor *next;
+    };
+
+    PendingFunctor *allocPendingFunctor();
+    void recyclePendingFunctors(PendingFunctor *first, PendingFunctor *last, int count);
+
     std::atomic_bool looping_;  // 原子操作，通过CAS实现
     std::atomic_bool quit_;     // 标识退出loop循环
 
     const pid_t threadId_;      // 记录当前thread的ID
     Timestamp pollReturnTime_;  // poller返回事件的channels的时间点
+    // 事件有变化，还没有提交给poller的channel，timerQueue_构造时就会用到，需要在它之前初始化
+    ChannelList dirtyChannels_;
+    // 比其他成员晚析构，析构过程中释放的连接还可以把内存还回来
+    std::unique_ptr<BufferPool> bufferPool_;
+    std::shared_ptr<Slab> connectionSlab_;
     std::unique_ptr<Poller> poller_;
+    std::unique_ptr<TimerQueue> timerQueue_;
+    std::unique_ptr<TimingWheel> timingWheel_;
 
     // 当mainLoop获取一个新用户的channel，通过轮询算法选择一个subloop
     // 通过该成员唤醒subloop来处理channel
@@ -65,7 +124,11 @@ private:
 
     ChannelList activeChannels_;
     Channel *currentActiveChannel_;
-    std::atomic_bool callingPendingFunctors_;  // 标识当前loop是否有需要执行的回调操作
-    std::vector<Functor> pendingFunctors_;     // 存储loop需要执行的所有回调操作
-    std::mutex mutex_;                         // 互斥锁保护vector线程安全
+    std::atomic_bool callingPendingFunctors_;       // 标识当前loop是否有需要执行的回调操作
+    MpscQueue<PendingFunctor> pendingFunctors_;     // 存储loop需要执行的所有回调操作，无锁队列
+    std::atomic<PendingFunctor *> freeFunctors_;    // 执行完的节点，生产者一次全部取走复用
+    std::atomic_int numFreeFunctors_;               // freeFunctors_中节点的大致个数
+
+    std::atomic_int numConnections_;
+    std::atomic<int64_t> pendingBytes_;
 };
\ No newline at end of file
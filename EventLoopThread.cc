@@ -1,10 +1,54 @@
 #include "EventLoopThread.h"
 
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 #include "EventLoop.h"
+#include "Logger.h"
+
+namespace {
+
+// numaif.h中的定义，直接使用系统调用，不依赖libnuma
+const int kMpolPreferred = 1;
+
+void bindToCpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+    if (ret != 0) {
+        LOG_ERROR("EventLoopThread bind to cpu %d failed:%d\n", cpu, ret);
+    }
+}
+
+// 当前线程之后分配的内存优先使用所在的NUMA节点，绑定cpu之后调用
+void preferLocalNode() {
+    unsigned cpu = 0, node = 0;
+    if (::syscall(SYS_getcpu, &cpu, &node, nullptr) < 0) {
+        LOG_ERROR("EventLoopThread getcpu failed:%d\n", errno);
+        return;
+    }
+    unsigned long mask[16] = {0};
+    if (node >= sizeof(mask) * 8) {
+        return;
+    }
+    mask[node / (sizeof(unsigned long) * 8)] |= 1UL << (node % (sizeof(unsigned long) * 8));
+    if (::syscall(SYS_set_mempolicy, kMpolPreferred, mask, sizeof(mask) * 8 + 1) < 0) {
+        // 没有NUMA支持的内核返回ENOSYS，忽略
+        LOG_ERROR("EventLoopThread set_mempolicy node %u failed:%d\n", node, errno);
+    }
+}
+
+}  // namespace
 
 EventLoopThread::EventLoopThread(const ThreadInitCallback& cb,
-                                 const std::string& name)
-    : loop_(nullptr), exiting_(false), thread_(std::bind(&EventLoopThread::threadFunc, this), name), mutex_(), cond_(), callback_(cb) {
+                                 const std::string& name,
+                                 EventLoop::Backend backend)
+    : loop_(nullptr), exiting_(false), thread_(std::bind(&EventLoopThread::threadFunc, this), name), mutex_(), cond_(), callback_(cb), backend_(backend)
+    , cpu_(-1), numaLocal_(false) {
 }
 
 EventLoopThread::~EventLoopThread() {
@@ -32,9 +76,17 @@ EventLoop* EventLoopThread::startLoop() {
 
 // 下面的方法，在单独的新线程里面运行的
 void EventLoopThread::threadFunc() {
+    // 先绑定cpu和内存策略，EventLoop自己的内存也从本地节点分配
+    if (cpu_ >= 0) {
+        bindToCpu(cpu_);
+    }
+    if (numaLocal_) {
+        preferLocalNode();
+    }
+
     // 创建一个独立的eventloop，和上面线程是对应的
     // one loop per thread
-    EventLoop loop;
+    EventLoop loop(backend_);
 
     if (callback_) {
         callback_(&loop);
@@ -8,16 +8,24 @@
 #include <string>
 #include <memory>
 
-class EventLoop;
+#include "EventLoop.h"
 
 class EventLoopThread : nocopyable {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
 
     EventLoopThread(const ThreadInitCallback &cb = ThreadInitCallback(), 
-                    const std::string& name = std::string());
+                    const std::string& name = std::string(),
+                    EventLoop::Backend backend = EventLoop::kDefaultBackend);
 
     ~EventLoopThread();
+
+    // 以下设置需要在startLoop之前调用
+    // 把loop线程绑定到cpu上运行，-1表示不绑定
+    void setCpu(int cpu) { cpu_ = cpu; }
+    // loop线程优先从所在NUMA节点分配内存，loop中创建的连接和缓冲区都在本地内存中
+    void setNumaLocal(bool on) { numaLocal_ = on; }
+
     EventLoop* startLoop();
 
 private:
@@ -29,4 +37,7 @@ private:
     std::mutex mutex_;
     std::condition_variable cond_;
     ThreadInitCallback callback_;
+    EventLoop::Backend backend_;
+    int cpu_;
+    bool numaLocal_;
 };
\ No newline at end of file
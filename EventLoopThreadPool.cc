@@ -1,12 +1,43 @@
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
 
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+
+// 从sysfs中读取cpu所在的NUMA节点，没有NUMA信息时返回-1
+int nodeOfCpu(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = ::opendir(path);
+    if (dir == nullptr) {
+        return -1;
+    }
+    int node = -1;
+    while (dirent *entry = ::readdir(dir)) {
+        if (strncmp(entry->d_name, "node", 4) == 0) {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    ::closedir(dir);
+    return node;
+}
+
+}  // namespace
+
 EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg)
     : baseLoop_(baseLoop)
     , name_(nameArg)
     , started_(false)
     , numThreads_(0)
-    , next_(0) {
+    , selector_(new RoundRobinSelector())
+    , backend_(EventLoop::kDefaultBackend)
+    , numaLocal_(false) {
 
 }
 
@@ -20,29 +51,36 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb) {
     for (int i = 0; i < numThreads_; ++i) {
         char buf[name_.size() + 32];
         snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), i);
-        EventLoopThread *t = new EventLoopThread(cb, buf);
+        EventLoopThread *t = new EventLoopThread(cb, buf, backend_);
+        if (!cpus_.empty()) {
+            t->setCpu(cpus_[i % cpus_.size()]);
+        }
+        t->setNumaLocal(numaLocal_);
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         // 底层创建线程，绑定一个新的EventLoop，并返回该loop的地址
         loops_.push_back(t->startLoop());
     }
 
+    buildCpuLoops();
+
     // 整个服务端只有一个线程，运行着baseLoop
     if (numThreads_ == 0 && cb) {
         cb(baseLoop_);
     }
 }
 
-// 如果工作在多线程中，baseloop_默认轮询的方式分配给Channel给subloop
+void EventLoopThreadPool::setLoopSelector(LoopSelector *selector) {
+    std::atomic_store(&selector_, std::shared_ptr<LoopSelector>(selector));
+}
+
+// 如果工作在多线程中，baseloop_按照选择策略分配给Channel给subloop
 EventLoop* EventLoopThreadPool::getNextLoop() {
     EventLoop *loop = baseLoop_;
 
-    // 通过轮询获取下一个处理事件的loop
     if (!loops_.empty()) {
-        loop = loops_[next_];
-        ++next_;
-        if (next_ >= loops_.size()) {
-            next_ = 0;
-        }
+        // 持有一份引用，其他线程同时切换策略时旧的selector在这次选择结束之后才释放
+        std::shared_ptr<LoopSelector> selector = std::atomic_load(&selector_);
+        loop = selector->select(loops_);
     }
     return loop;
 }
@@ -53,4 +91,41 @@ std::vector<EventLoop*> EventLoopThreadPool::getAllLoops() {
     } else {
         return loops_;
     }
-}
\ No newline at end of file
+}
+
+void EventLoopThreadPool::buildCpuLoops() {
+    if (cpus_.empty() || loops_.empty()) {
+        return;
+    }
+    long numCpus = ::sysconf(_SC_NPROCESSORS_CONF);
+    cpuLoops_.assign(numCpus > 0 ? numCpus : 0, -1);
+
+    std::vector<int> loopNodes(loops_.size());
+    for (size_t i = 0; i < loops_.size(); ++i) {
+        int cpu = cpus_[i % cpus_.size()];
+        loopNodes[i] = nodeOfCpu(cpu);
+        if (cpu >= 0 && cpu < numCpus && cpuLoops_[cpu] < 0) {
+            cpuLoops_[cpu] = static_cast<int>(i);
+        }
+    }
+
+    // 没有绑定loop的cpu，交给同一NUMA节点上的loop，轮流分配
+    size_t next = 0;
+    for (long cpu = 0; cpu < numCpus; ++cpu) {
+        if (cpuLoops_[cpu] >= 0) {
+            continue;
+        }
+        int node = nodeOfCpu(static_cast<int>(cpu));
+        if (node < 0) {
+            continue;
+        }
+        for (size_t n = 0; n < loops_.size(); ++n) {
+            size_t i = (next + n) % loops_.size();
+            if (loopNodes[i] == node) {
+                cpuLoops_[cpu] = static_cast<int>(i);
+                next = i + 1;
+                break;
+            }
+        }
+    }
+}
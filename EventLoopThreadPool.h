@@ -1,11 +1,12 @@
 #pragma once 
+#include "EventLoop.h"
+#include "LoopSelector.h"
 #include "nocopyable.h"
 #include <functional>
 #include <string>
 #include <vector>
 #include <memory>
 
-class EventLoop;
 class EventLoopThread;
 
 class EventLoopThreadPool : nocopyable {
@@ -16,22 +17,55 @@ public:
     ~EventLoopThreadPool();
 
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    // subloop使用的IO复用实现，需要在start之前设置
+    void setBackend(EventLoop::Backend backend) { backend_ = backend; }
 
     void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
-    // 如果工作在多线程中，baseloop_默认轮询的方式分配给Channel给subloop
+    // 第i个subloop绑定到cpus[i % cpus.size()]上运行，为空表示不绑定
+    void setCpuAffinity(const std::vector<int> &cpus) { cpus_ = cpus; }
+    // subloop优先从所在NUMA节点分配内存，一般和setCpuAffinity一起使用
+    void setNumaLocal(bool on) { numaLocal_ = on; }
+    bool numaLocal() const { return numaLocal_; }
+
+    // 选择subloop的策略，默认轮询，可以在运行中切换(线程安全)
+    // 旧的selector由正在使用它的getNextLoop持有到调用结束，不会在使用中被释放
+    void setLoopSelectPolicy(LoopSelector::Policy policy) { setLoopSelector(LoopSelector::newSelector(policy)); }
+    // 自定义的策略，接管selector的所有权
+    void setLoopSelector(LoopSelector *selector);
+
+    // 如果工作在多线程中，baseloop_按照选择策略分配给Channel给subloop
     EventLoop* getNextLoop();
 
     std::vector<EventLoop*> getAllLoops();
 
+    // 处理cpu上到达的连接的subloop的下标，优先是绑定在这个cpu上的loop，其次是同一NUMA节点上的loop
+    // 没有设置setCpuAffinity或者没有合适的loop时返回-1，start之后才能调用
+    int loopIndexForCpu(int cpu) const {
+        return cpu >= 0 && static_cast<size_t>(cpu) < cpuLoops_.size() ? cpuLoops_[cpu] : -1;
+    }
+    EventLoop *loopForCpu(int cpu) const {
+        int index = loopIndexForCpu(cpu);
+        return index >= 0 ? loops_[index] : nullptr;
+    }
+    // 以cpu为下标的loopIndexForCpu表
+    const std::vector<int> &cpuLoops() const { return cpuLoops_; }
+
     bool started() const { return started_; }
     const std::string name() const { return name_; }
 private:
+    void buildCpuLoops();
+
     EventLoop* baseLoop_; // EventLoop loop;
     std::string name_;
     bool started_;
     int numThreads_;
-    int next_;
+    // 通过std::atomic_load/atomic_store访问
+    std::shared_ptr<LoopSelector> selector_;
+    EventLoop::Backend backend_;
+    std::vector<int> cpus_;
+    bool numaLocal_;
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop*> loops_;
+    std::vector<int> cpuLoops_;
 };
\ No newline at end of file
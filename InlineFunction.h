@@ -0,0 +1,148 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * 只能移动的函数对象，带有内联存储(small buffer)
+ * 可调用对象不超过Capacity字节时直接存放在对象内部，不会分配内存，超过时才放到堆上
+ * 用于替代std::function，libstdc++的std::function只有16字节的内联空间，
+ * std::bind一个成员函数指针加上shared_ptr就已经放不下了
+ */
+template <typename Signature, size_t Capacity = 32>
+class InlineFunction;
+
+template <typename R, typename... Args, size_t Capacity>
+class InlineFunction<R(Args...), Capacity> {
+public:
+    InlineFunction() noexcept : ops_(nullptr) {}
+    InlineFunction(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+    template <typename F,
+              typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<F>::type, InlineFunction>::value>::type>
+    InlineFunction(F &&f) : ops_(nullptr) {
+        assign(std::forward<F>(f));
+    }
+
+    InlineFunction(InlineFunction &&other) noexcept : ops_(other.ops_) {
+        if (ops_) {
+            ops_->move(&storage_, &other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    InlineFunction &operator=(InlineFunction &&other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.ops_) {
+                ops_ = other.ops_;
+                ops_->move(&storage_, &other.storage_);
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InlineFunction &operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    InlineFunction(const InlineFunction &) = delete;
+    InlineFunction &operator=(const InlineFunction &) = delete;
+
+    ~InlineFunction() { reset(); }
+
+    R operator()(Args... args) {
+        return ops_->invoke(&storage_, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    // 可调用对象F是否可以存放在内联空间中
+    template <typename F>
+    struct fitsInline
+        : std::integral_constant<bool, sizeof(F) <= Capacity &&
+                                           alignof(F) <= alignof(void *) &&
+                                           std::is_nothrow_move_constructible<F>::value> {};
+
+private:
+    using Storage = typename std::aligned_storage<Capacity, alignof(void *)>::type;
+
+    // 类型擦除之后的操作表，每种可调用类型一份
+    struct Ops {
+        R (*invoke)(void *storage, Args &&...args);
+        void (*move)(void *dst, void *src);  // 移动到dst，并析构src
+        void (*destroy)(void *storage);
+    };
+
+    template <typename F>
+    struct InlineOps {
+        static R invoke(void *storage, Args &&...args) {
+            return (*static_cast<F *>(storage))(std::forward<Args>(args)...);
+        }
+        static void move(void *dst, void *src) {
+            F *f = static_cast<F *>(src);
+            ::new (dst) F(std::move(*f));
+            f->~F();
+        }
+        static void destroy(void *storage) { static_cast<F *>(storage)->~F(); }
+        static const Ops ops;
+    };
+
+    template <typename F>
+    struct HeapOps {
+        static R invoke(void *storage, Args &&...args) {
+            return (**static_cast<F **>(storage))(std::forward<Args>(args)...);
+        }
+        static void move(void *dst, void *src) {
+            *static_cast<F **>(dst) = *static_cast<F **>(src);
+        }
+        static void destroy(void *storage) { delete *static_cast<F **>(storage); }
+        static const Ops ops;
+    };
+
+    template <typename F>
+    void assign(F &&f) {
+        using Fn = typename std::decay<F>::type;
+        construct<Fn>(std::forward<F>(f), fitsInline<Fn>());
+    }
+
+    template <typename Fn, typename F>
+    void construct(F &&f, std::true_type) {
+        ::new (&storage_) Fn(std::forward<F>(f));
+        ops_ = &InlineOps<Fn>::ops;
+    }
+
+    template <typename Fn, typename F>
+    void construct(F &&f, std::false_type) {
+        *reinterpret_cast<Fn **>(&storage_) = new Fn(std::forward<F>(f));
+        ops_ = &HeapOps<Fn>::ops;
+    }
+
+    void reset() {
+        if (ops_) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    Storage storage_;
+    const Ops *ops_;
+};
+
+template <typename R, typename... Args, size_t Capacity>
+template <typename F>
+const typename InlineFunction<R(Args...), Capacity>::Ops
+    InlineFunction<R(Args...), Capacity>::InlineOps<F>::ops = {
+        &InlineOps<F>::invoke, &InlineOps<F>::move, &InlineOps<F>::destroy};
+
+template <typename R, typename... Args, size_t Capacity>
+template <typename F>
+const typename InlineFunction<R(Args...), Capacity>::Ops
+    InlineFunction<R(Args...), Capacity>::HeapOps<F>::ops = {
+        &HeapOps<F>::invoke, &HeapOps<F>::move, &HeapOps<F>::destroy};
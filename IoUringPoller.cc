@@ -0,0 +1,291 @@
+#include "IoUringPoller.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "Logger.h"
+
+namespace {
+int ioUringSetup(unsigned entries, io_uring_params *params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+// poll请求只认识这些事件，EPOLLET等epoll的控制位不能传给内核
+const uint32_t kPollEventMask = EPOLLIN | EPOLLPRI | EPOLLOUT | EPOLLRDHUP | EPOLLERR | EPOLLHUP;
+}  // namespace
+
+IoUringPoller *IoUringPoller::create(EventLoop *loop) {
+    IoUringPoller *poller = new IoUringPoller(loop);
+    if (!poller->setup(kRingEntries)) {
+        delete poller;
+        return nullptr;
+    }
+    return poller;
+}
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+    : Poller(loop)
+    , ringFd_(-1)
+    , ringPtr_(MAP_FAILED)
+    , ringSize_(0)
+    , sqes_(static_cast<io_uring_sqe *>(MAP_FAILED))
+    , sqesSize_(0)
+    , sqHead_(nullptr)
+    , sqTail_(nullptr)
+    , sqMask_(0)
+    , sqEntries_(0)
+    , sqeTail_(0)
+    , cqHead_(nullptr)
+    , cqTail_(nullptr)
+    , cqMask_(0)
+    , cqes_(nullptr)
+    , multishot_(false)
+    , nextGeneration_(1) {}
+
+IoUringPoller::~IoUringPoller() {
+    if (sqes_ != MAP_FAILED) {
+        ::munmap(sqes_, sqesSize_);
+    }
+    if (ringPtr_ != MAP_FAILED) {
+        ::munmap(ringPtr_, ringSize_);
+    }
+    if (ringFd_ >= 0) {
+        // 关闭io_uring时内核会取消所有未完成的poll请求
+        ::close(ringFd_);
+    }
+}
+
+bool IoUringPoller::setup(unsigned entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ringFd_ = ioUringSetup(entries, &params);
+    if (ringFd_ < 0) {
+        LOG_INFO("IoUringPoller::io_uring_setup error:%d", errno);
+        return false;
+    }
+
+    // 需要单次mmap映射两个队列、完成事件不丢失、io_uring_enter支持超时参数(5.11)
+    const unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & required) != required) {
+        LOG_INFO("IoUringPoller::kernel features 0x%x not supported", params.features);
+        return false;
+    }
+
+    // multishot poll和IORING_FEAT_RSRC_TAGS在同一个内核版本(5.13)中加入
+    multishot_ = (params.features & IORING_FEAT_RSRC_TAGS) != 0;
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ringSize_ = sqSize > cqSize ? sqSize : cqSize;
+    ringPtr_ = ::mmap(nullptr, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (ringPtr_ == MAP_FAILED) {
+        LOG_INFO("IoUringPoller::mmap ring error:%d", errno);
+        return false;
+    }
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        LOG_INFO("IoUringPoller::mmap sqes error:%d", errno);
+        return false;
+    }
+    sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+    char *ring = static_cast<char *>(ringPtr_);
+    sqHead_ = reinterpret_cast<unsigned *>(ring + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned *>(ring + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned *>(ring + params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+    sqeTail_ = *sqTail_;
+    // 提交队列的下标和sqes_一一对应，之后只需要移动队尾
+    unsigned *array = reinterpret_cast<unsigned *>(ring + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries_; ++i) {
+        array[i] = i;
+    }
+
+    cqHead_ = reinterpret_cast<unsigned *>(ring + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(ring + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned *>(ring + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(ring + params.cq_off.cqes);
+    return true;
+}
+
+unsigned IoUringPoller::pendingSubmissions() const {
+    return sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+}
+
+void IoUringPoller::submitPending() {
+    unsigned toSubmit = pendingSubmissions();
+    while (toSubmit > 0) {
+        int ret = ioUringEnter(ringFd_, toSubmit, 0, 0, nullptr, 0);
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            LOG_FATAL("IoUringPoller::io_uring_enter submit error:%d", errno);
+        }
+        toSubmit = pendingSubmissions();
+    }
+}
+
+io_uring_sqe *IoUringPoller::getSqe() {
+    if (pendingSubmissions() >= sqEntries_) {
+        submitPending();
+    }
+    io_uring_sqe *sqe = &sqes_[sqeTail_ & sqMask_];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int IoUringPoller::pollMask(Channel *channel) const {
+    return channel->isEdgeTriggered() ? channel->pollEvents() : channel->events();
+}
+
+void IoUringPoller::armPoll(Channel *channel, PollState &state) {
+    io_uring_sqe *sqe = getSqe();
+    state.generation = nextGeneration_++;
+    if (nextGeneration_ == 0) {
+        nextGeneration_ = 1;  // 0留给取消请求自身的完成事件
+    }
+    state.armed = true;
+    state.events = pollMask(channel);
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = channel->fd();
+    sqe->poll32_events = static_cast<uint32_t>(state.events) & kPollEventMask;
+    if (channel->isEdgeTriggered()) {
+        // 每次fd状态变化都产生一个完成事件，和EPOLLET一样需要处理者读写到EAGAIN
+        sqe->len = IORING_POLL_ADD_MULTI;
+    }
+    sqe->user_data = makeUserData(channel->fd(), state.generation);
+    __atomic_store_n(sqTail_, ++sqeTail_, __ATOMIC_RELEASE);
+}
+
+void IoUringPoller::cancelPoll(int fd, PollState &state) {
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->addr = makeUserData(fd, state.generation);
+    sqe->user_data = 0;
+    __atomic_store_n(sqTail_, ++sqeTail_, __ATOMIC_RELEASE);
+    // 被取消的请求的完成事件带着旧的代数，收到之后直接丢弃
+    state.generation = 0;
+    state.armed = false;
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList &activeChannels) {
+    LOG_DEBUG("IoUringPoller::%s() => fd total count:%lu\n", __FUNCTION__, channels_.size());
+
+    // 上一轮触发过的channel重新提交poll请求，仍然有数据可读时会立即完成
+    for (int fd : pendingArms_) {
+        ChannelTable::Entry *entry = channels_.find(fd);
+        if (entry != nullptr && !states_[fd].armed && !entry->channel->isNoneEvent()) {
+            armPoll(entry->channel, states_[fd]);
+        }
+    }
+    pendingArms_.clear();
+
+    io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    struct __kernel_timespec ts;
+    if (timeoutMs >= 0) {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+
+    // 提交所有请求并等待至少一个完成事件，一次系统调用
+    int ret = ioUringEnter(ringFd_, pendingSubmissions(), 1,
+                           IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    int saveErrno = errno;
+
+    Timestamp now(Timestamp::now());
+
+    if (ret < 0 && saveErrno != ETIME && saveErrno != EINTR) {
+        errno = saveErrno;
+        LOG_ERROR("IoUringPoller::poll() error:%d", saveErrno);
+    }
+    fillActiveChannels(activeChannels);
+    return now;
+}
+
+void IoUringPoller::fillActiveChannels(ChannelList &activeChannels) {
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const io_uring_cqe &cqe = cqes_[head & cqMask_];
+        uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32);
+        int fd = static_cast<int>(static_cast<uint32_t>(cqe.user_data));
+        if (generation == 0) {
+            continue;  // 取消请求自身的完成事件
+        }
+
+        ChannelTable::Entry *entry = channels_.find(fd);
+        if (entry == nullptr || states_[fd].generation != generation) {
+            continue;  // 已经取消或者fd已经被复用
+        }
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            // 一次性的请求已经完成，或者multishot请求被内核终止了，需要重新提交
+            states_[fd].armed = false;
+            pendingArms_.push_back(fd);
+        }
+
+        if (cqe.res == -ECANCELED) {
+            continue;
+        }
+        Channel *channel = entry->channel;
+        channel->set_revents(cqe.res < 0 ? static_cast<int>(EPOLLERR) : cqe.res);
+        activeChannels.push_back(channel);
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+    if (!activeChannels.empty()) {
+        LOG_DEBUG("IoUringPoller::poll() %lu events happened \n", activeChannels.size());
+    }
+}
+
+void IoUringPoller::updateChannel(Channel *channel) {
+    int fd = channel->fd();
+    LOG_DEBUG("IoUringPoller::%s => fd=%d events=%d\n", __FUNCTION__, fd, channel->events());
+
+    channels_.insert(fd, channel);
+    if (static_cast<size_t>(fd) >= states_.size()) {
+        states_.resize(std::max(static_cast<size_t>(fd) + 1, states_.size() * 2));
+    }
+    if (channel->isEdgeTriggered() && !multishot_) {
+        // 内核不支持multishot poll，退化为水平触发，连接仍然会读写到EAGAIN
+        channel->setEdgeTriggered(false);
+    }
+    PollState &state = states_[fd];
+    if (state.armed && state.events == pollMask(channel)) {
+        return;
+    }
+    if (state.armed) {
+        // 关注的事件变了，取消旧的poll请求，两个请求在下一次io_uring_enter中一起提交
+        cancelPoll(fd, state);
+    }
+    if (!channel->isNoneEvent()) {
+        armPoll(channel, state);
+    }
+}
+
+void IoUringPoller::removeChannel(Channel *channel) {
+    int fd = channel->fd();
+    LOG_INFO("IoUringPoller::%s => fd=%d \n", __FUNCTION__, fd);
+
+    if (channels_.find(fd) != nullptr) {
+        if (states_[fd].armed) {
+            cancelPoll(fd, states_[fd]);
+        }
+        states_[fd] = PollState();
+    }
+    channels_.erase(fd);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "Channel.h"
+#include "Poller.h"
+#include "Timestamp.h"
+
+/**
+ * 基于io_uring的Poller，直接使用io_uring_setup/io_uring_enter系统调用
+ * 每个channel对应一个poll请求，关注事件的变化和poll请求的提交都只是填写提交队列
+ * 每次poll只需要一次io_uring_enter，同时完成提交请求、等待事件和超时
+ * 水平触发的channel使用一次性的poll请求，触发之后在下一次poll之前重新提交，保持和epoll一样的语义
+ * 边缘触发的channel使用multishot poll请求，提交一次之后一直有效
+ */
+class IoUringPoller : public Poller {
+public:
+    // 内核不支持或者创建失败时返回nullptr，由调用者回退到epoll
+    static IoUringPoller *create(EventLoop *loop);
+    ~IoUringPoller() override;
+
+    Timestamp poll(int timeoutMs, ChannelList &activeChannels) override;
+    void updateChannel(Channel *channel) override;
+    void removeChannel(Channel *channel) override;
+
+private:
+    static const unsigned kRingEntries = 1024;
+
+    // 每个fd上poll请求的状态
+    struct PollState {
+        uint32_t generation{0};  // 当前poll请求的代数，用来识别已经取消的请求的过期完成事件
+        bool armed{false};       // 是否有还未完成的poll请求
+        int events{0};           // 未完成的poll请求关注的事件
+    };
+
+    explicit IoUringPoller(EventLoop *loop);
+    bool setup(unsigned entries);
+
+    // 取一个空闲的提交队列项，队列满时先提交一次
+    io_uring_sqe *getSqe();
+    void submitPending();
+    unsigned pendingSubmissions() const;
+
+    // 提交给内核的poll事件
+    int pollMask(Channel *channel) const;
+    void armPoll(Channel *channel, PollState &state);
+    void cancelPoll(int fd, PollState &state);
+    void fillActiveChannels(ChannelList &activeChannels);
+
+    static uint64_t makeUserData(int fd, uint32_t generation) {
+        return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+    }
+
+    int ringFd_;
+
+    // 提交队列和完成队列的共享内存
+    void *ringPtr_;
+    size_t ringSize_;
+    io_uring_sqe *sqes_;
+    size_t sqesSize_;
+
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    unsigned sqeTail_;  // 本地的提交队列尾部，填写完一项之后同步到sqTail_
+
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned cqMask_;
+    io_uring_cqe *cqes_;
+
+    bool multishot_;  // 内核是否支持multishot poll(5.13)
+    uint32_t nextGeneration_;
+    std::vector<PollState> states_;  // 以fd为下标，和channels_对应
+    std::vector<int> pendingArms_;  // 上一轮触发过，需要重新提交poll请求的fd
+};
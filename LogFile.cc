@@ -0,0 +1,105 @@
+#include "LogFile.h"
+
+#include <unistd.h>
+
+LogFile::LogFile(const std::string &basename, off_t rollSize, int flushInterval)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , flushInterval_(flushInterval)
+    , startOfPeriod_(0)
+    , lastRoll_(0)
+    , lastFlush_(0)
+    , fp_(nullptr)
+    , writtenBytes_(0) {
+    rollFile();
+}
+
+LogFile::~LogFile() {
+    if (fp_) {
+        ::fclose(fp_);
+    }
+}
+
+void LogFile::append(const char *logline, size_t len) {
+    if (fp_ == nullptr) {
+        return;
+    }
+
+    size_t written = 0;
+    while (written != len) {
+        size_t n = ::fwrite_unlocked(logline + written, 1, len - written, fp_);
+        if (n == 0) {
+            // 磁盘写满等错误，只能放弃这部分日志
+            fprintf(stderr, "LogFile::append() failed\n");
+            break;
+        }
+        written += n;
+    }
+    writtenBytes_ += written;
+
+    time_t now = ::time(NULL);
+    if (writtenBytes_ > rollSize_) {
+        rollFile();
+    } else if (now / kRollPerSeconds * kRollPerSeconds != startOfPeriod_) {
+        // 跨天了，滚动日志
+        rollFile();
+    } else if (now - lastFlush_ > flushInterval_) {
+        lastFlush_ = now;
+        ::fflush(fp_);
+    }
+}
+
+void LogFile::flush() {
+    if (fp_) {
+        ::fflush(fp_);
+    }
+}
+
+bool LogFile::rollFile() {
+    time_t now = 0;
+    std::string filename = getLogFileName(basename_, &now);
+    time_t start = now / kRollPerSeconds * kRollPerSeconds;
+
+    // 同一秒之内不重复滚动，否则会打开同名文件
+    if (now <= lastRoll_) {
+        return false;
+    }
+
+    FILE *fp = ::fopen(filename.c_str(), "ae");
+    if (fp == nullptr) {
+        fprintf(stderr, "LogFile::rollFile() open %s failed\n", filename.c_str());
+        return false;
+    }
+    if (fp_) {
+        ::fclose(fp_);
+    }
+    fp_ = fp;
+    ::setbuffer(fp_, buffer_, sizeof(buffer_));
+
+    lastRoll_ = now;
+    lastFlush_ = now;
+    startOfPeriod_ = start;
+    writtenBytes_ = 0;
+    return true;
+}
+
+// basename.20240101-120000.hostname.pid.log
+std::string LogFile::getLogFileName(const std::string &basename, time_t *now) {
+    std::string filename(basename);
+
+    char timebuf[32];
+    struct tm tm;
+    *now = ::time(NULL);
+    ::localtime_r(now, &tm);
+    ::strftime(timebuf, sizeof(timebuf), ".%Y%m%d-%H%M%S.", &tm);
+    filename += timebuf;
+
+    char hostname[256] = "unknownhost";
+    ::gethostname(hostname, sizeof(hostname) - 1);
+    filename += hostname;
+
+    char pidbuf[32];
+    snprintf(pidbuf, sizeof(pidbuf), ".%d.log", ::getpid());
+    filename += pidbuf;
+    return filename;
+}
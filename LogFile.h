@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include <string>
+
+#include "nocopyable.h"
+
+/**
+ * 日志文件，只由AsyncLogging的后端线程访问
+ * 按文件大小和时间(每天)进行滚动
+ */
+class LogFile : nocopyable {
+public:
+    LogFile(const std::string &basename, off_t rollSize, int flushInterval = 3);
+    ~LogFile();
+
+    void append(const char *logline, size_t len);
+    void flush();
+    // 滚动日志，创建一个新的日志文件
+    bool rollFile();
+
+private:
+    static std::string getLogFileName(const std::string &basename, time_t *now);
+
+    const std::string basename_;
+    const off_t rollSize_;     // 日志文件达到该大小之后滚动
+    const int flushInterval_;  // 刷新到磁盘的间隔，单位秒
+
+    time_t startOfPeriod_;  // 当前日志文件所属的那一天
+    time_t lastRoll_;       // 上一次滚动的时间
+    time_t lastFlush_;      // 上一次刷新的时间
+
+    FILE *fp_;
+    off_t writtenBytes_;
+    char buffer_[64 * 1024];  // 文件流的用户态缓冲区
+
+    static const int kRollPerSeconds = 60 * 60 * 24;
+};
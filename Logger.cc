@@ -1,34 +1,90 @@
 #include "Logger.h"
-#include "Timestamp.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+namespace {
+
+void defaultOutput(const char *msg, int len) {
+    ::fwrite(msg, 1, len, stdout);
+}
+
+void defaultFlush() {
+    ::fflush(stdout);
+}
+
+Logger::OutputFunc g_output = defaultOutput;
+Logger::FlushFunc g_flush = defaultFlush;
+
+const char *kLevelName[] = {
+    "[DEBUG] ",
+    "[INFO ] ",
+    "[ERROR] ",
+    "[FATAL] ",
+};
+const int kLevelNameLen = 8;
+
+// 每个线程缓存上一次格式化的时间，同一秒之内的日志不用重复格式化
+__thread time_t t_lastSecond = 0;
+__thread char t_time[32];
+__thread int t_timeLen = 0;
+
+}  // namespace
+
+std::atomic_int Logger::logLevel_(INFO);
 
 // 获取日志唯一的实例对象
 Logger& Logger::instance() {
     static Logger logger;
     return logger;
 }
-// 设置日志级别
-void Logger::setLogLevel(int level) {
-    logLevel_ = level;
-}
-// 写日志 [级别信息] time : msg
-void Logger::log(std::string msg) {
-    switch (logLevel_) {
-    case INFO:
-        std::cout << "[INFO ] ";
-        break;
-    case ERROR:
-        std::cout << "[ERROR] ";
-        break;
-    case FATAL:
-        std::cout << "[FATAL] ";
-        break;
-    case DEBUG:
-        std::cout << "[DEBUG] ";
-        break;
-    default:
-        break;
+
+// 写日志 [级别信息] time - msg
+void Logger::log(LogLevel level, const char *fmt, ...) {
+    char buf[1024 + 64];
+    int len = 0;
+
+    memcpy(buf, kLevelName[level], kLevelNameLen);
+    len += kLevelNameLen;
+
+    time_t now = ::time(NULL);
+    if (now != t_lastSecond) {
+        t_lastSecond = now;
+        struct tm tm_time;
+        ::localtime_r(&now, &tm_time);
+        t_timeLen = static_cast<int>(::strftime(t_time, sizeof(t_time), "%Y-%m-%d %H:%M:%S - ", &tm_time));
     }
+    memcpy(buf + len, t_time, t_timeLen);
+    len += t_timeLen;
+
+    va_list args;
+    va_start(args, fmt);
+    int n = ::vsnprintf(buf + len, sizeof(buf) - len - 1, fmt, args);
+    va_end(args);
+    if (n > 0) {
+        // 超长的日志被截断
+        len += std::min(n, static_cast<int>(sizeof(buf)) - len - 2);
+    }
+    if (buf[len - 1] != '\n') {
+        buf[len++] = '\n';
+    }
+
+    g_output(buf, len);
 
-    // 打印时间和msg
-    std::cout << Timestamp::now().toString() << " - " << msg << std::endl;
-}
\ No newline at end of file
+    // 错误信息需要尽快落地
+    if (level >= ERROR) {
+        g_flush();
+    }
+}
+
+void Logger::setOutput(OutputFunc out) {
+    g_output = out;
+}
+
+void Logger::setFlush(FlushFunc flush) {
+    g_flush = flush;
+}
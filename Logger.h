@@ -1,70 +1,70 @@
 #pragma once
 
+#include <stdlib.h>
+
+#include <atomic>
 #include <string>
 
 #include "nocopyable.h"
 
-// LOG_INFO("%s %d", arg1, arg2)
-#define LOG_INFO(logmsgFormat, ...)                       \
-    do {                                                  \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(INFO);                         \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
-    } while (0)
-
-#define LOG_ERROR(logmsgFormat, ...)                      \
-    do {                                                  \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(ERROR);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
-    } while (0)
+// 日志的级别 DEBUG INFO ERROR FATAL，数值越大越严重
+enum LogLevel {
+    DEBUG,  // 调试信息
+    INFO,   // 普通信息
+    ERROR,  // 错误信息
+    FATAL,  // core dump信息
+};
 
-#ifdef LOG_DEBUG_ENABLE
-#define LOG_FATAL(logmsgFormat, ...)                      \
-    do {                                                  \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(FATAL);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
-        exit(-1);                                         \
-    } while (0)
+// 编译期的最低日志级别，低于该级别的LOG_*调用点会被编译器直接消除
+// release(NDEBUG)构建默认只保留ERROR及以上，可以通过-DLITENET_MIN_LOG_LEVEL=0覆盖
+#ifndef LITENET_MIN_LOG_LEVEL
+#ifdef NDEBUG
+#define LITENET_MIN_LOG_LEVEL 2
 #else
-#define LOG_FATAL(logmsgFormat, ...)
+#define LITENET_MIN_LOG_LEVEL 0
+#endif
 #endif
 
-#define LOG_DEBUG(logmsgFormat, ...)                      \
-    do {                                                  \
-        Logger &logger = Logger::instance();              \
-        logger.setLogLevel(DEBUG);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+// 先判断日志级别再格式化，级别不够时只有一次分支判断
+#define LITENET_LOG(level, logmsgFormat, ...)                               \
+    do {                                                                    \
+        if (LITENET_MIN_LOG_LEVEL <= level && Logger::logLevel() <= level) { \
+            Logger::instance().log(level, logmsgFormat, ##__VA_ARGS__);     \
+        }                                                                   \
     } while (0)
 
-// 日志的级别 INFO ERROR FATAL DEBUG
-enum LogLevel {
-    INFO,   // 普通信息
-    ERROR,  // 错误信息
-    FATAL,  // core dump信息
-    DEBUG,  // 调试信息
-};
+// LOG_INFO("%s %d", arg1, arg2)
+#define LOG_DEBUG(logmsgFormat, ...) LITENET_LOG(DEBUG, logmsgFormat, ##__VA_ARGS__)
+#define LOG_INFO(logmsgFormat, ...) LITENET_LOG(INFO, logmsgFormat, ##__VA_ARGS__)
+#define LOG_ERROR(logmsgFormat, ...) LITENET_LOG(ERROR, logmsgFormat, ##__VA_ARGS__)
+
+// FATAL日志不受级别控制，输出之后直接退出进程
+#define LOG_FATAL(logmsgFormat, ...)                                  \
+    do {                                                              \
+        Logger::instance().log(FATAL, logmsgFormat, ##__VA_ARGS__);   \
+        exit(-1);                                                     \
+    } while (0)
 
 // 输出一个日志类
 class Logger : nocopyable {
 public:
     // 获取日志唯一的实例对象
     static Logger &instance();
-    // 设置日志级别
-    void setLogLevel(int level);
-    // 写日志
-    void log(std::string msg);
+
+    // 运行期的日志级别，低于该级别的日志不会被格式化和输出
+    static LogLevel logLevel() { return static_cast<LogLevel>(logLevel_.load(std::memory_order_relaxed)); }
+    static void setLogLevel(LogLevel level) { logLevel_.store(level, std::memory_order_relaxed); }
+
+    // 写日志 [级别信息] time - msg
+    void log(LogLevel level, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+    // 日志的输出目的地，默认输出到stdout，可以替换成AsyncLogging
+    using OutputFunc = void (*)(const char *msg, int len);
+    using FlushFunc = void (*)();
+    static void setOutput(OutputFunc out);
+    static void setFlush(FlushFunc flush);
 
 private:
-    int logLevel_;  // 日志级别
+    static std::atomic_int logLevel_;  // 日志级别，所有线程共享
     Logger() {}
-};
\ No newline at end of file
+};
@@ -0,0 +1,74 @@
+#include "LoopSelector.h"
+
+#include "EventLoop.h"
+
+LoopSelector *LoopSelector::newSelector(Policy policy) {
+    switch (policy) {
+    case kLeastConnections:
+        return new LeastConnectionsSelector();
+    case kLeastPendingBytes:
+        return new LeastPendingBytesSelector();
+    case kPowerOfTwoChoices:
+        return new PowerOfTwoChoicesSelector();
+    default:
+        return new RoundRobinSelector();
+    }
+}
+
+EventLoop *RoundRobinSelector::select(const std::vector<EventLoop *> &loops) {
+    if (next_ >= loops.size()) {
+        next_ = 0;
+    }
+    return loops[next_++];
+}
+
+// 负载相同时取靠前的loop
+EventLoop *LeastConnectionsSelector::select(const std::vector<EventLoop *> &loops) {
+    EventLoop *best = loops[0];
+    int bestConns = best->numConnections();
+    for (size_t i = 1; i < loops.size(); ++i) {
+        int conns = loops[i]->numConnections();
+        if (conns < bestConns) {
+            best = loops[i];
+            bestConns = conns;
+        }
+    }
+    return best;
+}
+
+EventLoop *LeastPendingBytesSelector::select(const std::vector<EventLoop *> &loops) {
+    EventLoop *best = loops[0];
+    int64_t bestBytes = best->pendingBytes();
+    int bestConns = best->numConnections();
+    for (size_t i = 1; i < loops.size(); ++i) {
+        int64_t bytes = loops[i]->pendingBytes();
+        int conns = loops[i]->numConnections();
+        if (bytes < bestBytes || (bytes == bestBytes && conns < bestConns)) {
+            best = loops[i];
+            bestBytes = bytes;
+            bestConns = conns;
+        }
+    }
+    return best;
+}
+
+EventLoop *PowerOfTwoChoicesSelector::select(const std::vector<EventLoop *> &loops) {
+    size_t n = loops.size();
+    if (n == 1) {
+        return loops[0];
+    }
+    // 两个不同的下标
+    size_t a = nextRandom() % n;
+    size_t b = nextRandom() % (n - 1);
+    if (b >= a) {
+        ++b;
+    }
+    return loops[b]->numConnections() < loops[a]->numConnections() ? loops[b] : loops[a];
+}
+
+uint64_t PowerOfTwoChoicesSelector::nextRandom() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 7;
+    state_ ^= state_ << 17;
+    return state_;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "nocopyable.h"
+
+class EventLoop;
+
+/**
+ * 为新连接选择subloop的策略，由EventLoopThreadPool::getNextLoop调用
+ * 只在接受连接的线程中调用，实现不需要考虑线程安全
+ * 负载信息来自各个loop的计数(EventLoop::numConnections/pendingBytes)，在其他线程中读取，只是近似值
+ */
+class LoopSelector : nocopyable {
+public:
+    enum Policy {
+        kRoundRobin,          // 轮询
+        kLeastConnections,    // 连接数最少的loop
+        kLeastPendingBytes,   // 发送队列积压字节数最少的loop，连接数作为次要条件
+        kPowerOfTwoChoices    // 随机选两个loop，取连接数较少的一个，避免所有连接同时涌向同一个loop
+    };
+
+    virtual ~LoopSelector() = default;
+
+    // loops非空
+    virtual EventLoop *select(const std::vector<EventLoop *> &loops) = 0;
+
+    static LoopSelector *newSelector(Policy policy);
+};
+
+class RoundRobinSelector : public LoopSelector {
+public:
+    RoundRobinSelector() : next_(0) {}
+    EventLoop *select(const std::vector<EventLoop *> &loops) override;
+
+private:
+    size_t next_;
+};
+
+class LeastConnectionsSelector : public LoopSelector {
+public:
+    EventLoop *select(const std::vector<EventLoop *> &loops) override;
+};
+
+class LeastPendingBytesSelector : public LoopSelector {
+public:
+    EventLoop *select(const std::vector<EventLoop *> &loops) override;
+};
+
+class PowerOfTwoChoicesSelector : public LoopSelector {
+public:
+    explicit PowerOfTwoChoicesSelector(uint64_t seed = 0x9e3779b97f4a7c15ULL) : state_(seed) {}
+    EventLoop *select(const std::vector<EventLoop *> &loops) override;
+
+private:
+    uint64_t nextRandom();
+
+    uint64_t state_;  // xorshift64的状态
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+
+#include "nocopyable.h"
+
+/**
+ * 侵入式的无锁多生产者单消费者队列，Node需要包含一个 Node *next 成员
+ * 生产者通过CAS把节点压入链表头部，消费者一次exchange取走所有节点并反转成FIFO顺序
+ * 队列不负责节点的内存管理
+ */
+template <typename Node>
+class MpscQueue : nocopyable {
+public:
+    MpscQueue() : head_(nullptr) {}
+
+    // 生产者调用，线程安全，返回push之前队列是否为空
+    bool push(Node *node) {
+        Node *head = head_.load(std::memory_order_relaxed);
+        do {
+            node->next = head;
+        } while (!head_.compare_exchange_weak(head, node,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+        return head == nullptr;
+    }
+
+    // 消费者调用，取出当前所有的节点，返回按push顺序排列的链表
+    Node *popAll() {
+        Node *head = head_.exchange(nullptr, std::memory_order_acquire);
+        Node *prev = nullptr;
+        while (head) {
+            Node *next = head->next;
+            head->next = prev;
+            prev = head;
+            head = next;
+        }
+        return prev;
+    }
+
+    bool empty() const { return head_.load(std::memory_order_relaxed) == nullptr; }
+
+private:
+    std::atomic<Node *> head_;
+};
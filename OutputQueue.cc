@@ -0,0 +1,159 @@
+#include "OutputQueue.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+void closeFile(const int *fd) {
+    ::close(*fd);
+    delete fd;
+}
+}  // namespace
+
+OutputQueue::FileHandle OutputQueue::makeFileHandle(int fd) {
+    return FileHandle(new int(fd), closeFile);
+}
+
+void OutputQueue::append(const char *data, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    if (!segments_.empty()) {
+        Segment &tail = segments_.back();
+        if (tail.mergeable && tail.owned.size() + len <= kMaxMergeBytes) {
+            tail.owned.append(data, len);
+            tail.len += len;
+            bytes_ += len;
+            return;
+        }
+    }
+
+    segments_.emplace_back();
+    Segment &seg = segments_.back();
+    seg.owned.assign(data, len);
+    seg.len = len;
+    seg.mergeable = true;
+    bytes_ += len;
+}
+
+void OutputQueue::append(std::string &&data) {
+    if (data.empty()) {
+        return;
+    }
+    segments_.emplace_back();
+    Segment &seg = segments_.back();
+    seg.owned.swap(data);
+    seg.len = seg.owned.size();
+    bytes_ += seg.len;
+}
+
+void OutputQueue::append(Buffer &&buf) {
+    size_t len = buf.readableBytes();
+    if (len == 0) {
+        return;
+    }
+    std::shared_ptr<Buffer> chunk = std::make_shared<Buffer>(std::move(buf));
+    const char *data = chunk->peek();
+    append(std::move(chunk), data, len);
+}
+
+void OutputQueue::append(std::shared_ptr<const void> holder, const char *data, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    segments_.emplace_back();
+    Segment &seg = segments_.back();
+    seg.holder = std::move(holder);
+    seg.data = data;
+    seg.len = len;
+    bytes_ += len;
+}
+
+void OutputQueue::appendFile(const FileHandle &file, off_t offset, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    segments_.emplace_back();
+    Segment &seg = segments_.back();
+    seg.holder = file;
+    seg.fileFd = *file;
+    seg.fileOffset = offset;
+    seg.len = len;
+    bytes_ += len;
+}
+
+ssize_t OutputQueue::writeFd(int fd, int *saveErrno) {
+    if (!segments_.empty() && segments_[head_].fileFd >= 0) {
+        return sendFileSegment(fd, segments_[head_], saveErrno);
+    }
+
+    struct iovec vec[IOV_MAX];
+    int iovcnt = 0;
+    for (size_t i = head_; i < segments_.size(); ++i) {
+        const Segment &seg = segments_[i];
+        if (iovcnt == IOV_MAX || seg.fileFd >= 0) {
+            break;
+        }
+        vec[iovcnt].iov_base = const_cast<char *>(seg.begin() + seg.offset);
+        vec[iovcnt].iov_len = seg.len - seg.offset;
+        ++iovcnt;
+    }
+
+    ssize_t n = ::writev(fd, vec, iovcnt);
+    if (n < 0) {
+        *saveErrno = errno;
+    }
+    return n;
+}
+
+ssize_t OutputQueue::sendFileSegment(int fd, Segment &seg, int *saveErrno) {
+    // sendfile不会修改fileFd的文件偏移，同一个文件可以被多个连接同时发送
+    off_t offset = seg.fileOffset + static_cast<off_t>(seg.offset);
+    ssize_t n = ::sendfile(fd, seg.fileFd, &offset, seg.len - seg.offset);
+    if (n < 0) {
+        *saveErrno = errno;
+    } else if (n == 0) {
+        // 文件被截断了，剩余的数据永远发送不出去
+        *saveErrno = EIO;
+        n = -1;
+    }
+    return n;
+}
+
+void OutputQueue::retrieve(size_t len) {
+    while (len > 0 && !segments_.empty()) {
+        Segment &seg = segments_[head_];
+        size_t remaining = seg.len - seg.offset;
+        if (len >= remaining) {
+            len -= remaining;
+            bytes_ -= remaining;
+            popFront();
+        } else {
+            seg.offset += len;
+            bytes_ -= len;
+            len = 0;
+        }
+    }
+}
+
+void OutputQueue::popFront() {
+    // 马上释放数据段持有的内存和文件
+    segments_[head_] = Segment();
+    if (++head_ == segments_.size()) {
+        segments_.clear();
+        head_ = 0;
+    } else if (head_ >= kCompactSegments && head_ * 2 >= segments_.size()) {
+        // 一直没有发完时，前面已经发送的数据段占了一半以上，整体前移
+        segments_.erase(segments_.begin(), segments_.begin() + head_);
+        head_ = 0;
+    }
+}
+
+void OutputQueue::retrieveAll() {
+    segments_.clear();
+    head_ = 0;
+    bytes_ = 0;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Buffer.h"
+#include "nocopyable.h"
+
+/**
+ * TCPConnection的发送队列，由若干数据段组成
+ * 数据段可以是拷贝进来的小数据、转移所有权的string、引用计数的共享数据或者Buffer块
+ * 发送时通过writev一次把多个数据段写入socket，不需要先把它们拼接到一块连续内存中
+ * 文件数据段通过sendfile发送，文件内容不经过用户空间
+ * 数据段放在vector中，从head_开始是还没有发完的，空的队列不占用堆内存，大量空闲连接不需要为它分配内存
+ */
+class OutputQueue : nocopyable {
+public:
+    // 文件数据段持有的文件描述符，最后一个引用释放时关闭
+    using FileHandle = std::shared_ptr<const int>;
+    // 接管fd的所有权
+    static FileHandle makeFileHandle(int fd);
+
+    OutputQueue() : head_(0), bytes_(0) {}
+
+    // 队列中还未发送的字节数
+    size_t readableBytes() const { return bytes_; }
+    bool empty() const { return bytes_ == 0; }
+    size_t numSegments() const { return segments_.size() - head_; }
+
+    // 拷贝数据，小块数据会合并到队尾的拷贝段中
+    void append(const char *data, size_t len);
+    // 转移string的所有权，不拷贝
+    void append(std::string &&data);
+    // 转移Buffer的数据，不拷贝，调用之后buf只能被析构
+    void append(Buffer &&buf);
+    // 共享的数据片段，holder保证[data, data + len)在发送完之前有效
+    void append(std::shared_ptr<const void> holder, const char *data, size_t len);
+    // 文件[offset, offset + len)区间的数据
+    void appendFile(const FileHandle &file, off_t offset, size_t len);
+
+    // 队列头部是文件数据段时通过sendfile发送，否则通过writev发送到下一个文件数据段为止
+    // 一次最多IOV_MAX个数据段，文件比声明的长度短时返回-1，saveErrno为EIO
+    ssize_t writeFd(int fd, int *saveErrno);
+    // 丢弃队列头部len字节的数据
+    void retrieve(size_t len);
+    void retrieveAll();
+
+private:
+    struct Segment {
+        std::string owned;                   // 拥有所有权的数据
+        std::shared_ptr<const void> holder;  // 共享数据的所有者
+        const char *data{nullptr};           // holder不为空时指向共享的数据
+        size_t len{0};
+        size_t offset{0};                    // 已经发送的字节数
+        bool mergeable{false};               // 是否可以继续追加拷贝的数据
+        int fileFd{-1};                      // 文件数据段的文件描述符，由holder持有
+        off_t fileOffset{0};                 // 文件数据段在文件中的起始位置
+
+        const char *begin() const { return holder ? data : owned.data(); }
+    };
+
+    // 拷贝段最多合并到这么大，避免频繁地扩容一块大内存
+    static const size_t kMaxMergeBytes = 64 * 1024;
+    // 已经发完的数据段至少有这么多个时才整体前移
+    static const size_t kCompactSegments = 16;
+
+    ssize_t sendFileSegment(int fd, Segment &seg, int *saveErrno);
+    // 删除头部已经发完的数据段
+    void popFront();
+
+    std::vector<Segment> segments_;
+    size_t head_;  // 第一个没有发完的数据段，队列为空时为0
+    size_t bytes_;
+};
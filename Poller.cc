@@ -4,6 +4,6 @@ Poller::Poller(EventLoop *loop)
     : owenrLoop_(loop) {}
 
 bool Poller::hasChannel(Channel *channel) const {
-    auto it = channels_.find(channel->fd());
-    return it != channels_.end() && it->second == channel;
+    const ChannelTable::Entry *entry = channels_.find(channel->fd());
+    return entry != nullptr && entry->channel == channel;
 }
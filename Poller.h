@@ -1,6 +1,6 @@
 #pragma once
 
-#include <unordered_map>
+#include <algorithm>
 #include <vector>
 
 #include "Channel.h"
@@ -8,6 +8,56 @@
 #include "Timestamp.h"
 #include "nocopyable.h"
 
+// 以fd为下标的channel表，fd是小而密集的整数，直接用数组代替哈希表
+// 建立和断开连接时不需要计算哈希和分配节点，查找只访问一个表项
+class ChannelTable {
+public:
+    struct Entry {
+        Channel *channel{nullptr};
+        int state{0};  // channel在poller中的注册状态，由具体的Poller定义
+    };
+
+    ChannelTable() : size_(0) {}
+
+    // fd没有对应的channel时返回nullptr
+    Entry *find(int fd) {
+        if (fd < 0 || static_cast<size_t>(fd) >= entries_.size() || entries_[fd].channel == nullptr) {
+            return nullptr;
+        }
+        return &entries_[fd];
+    }
+    const Entry *find(int fd) const {
+        return const_cast<ChannelTable *>(this)->find(fd);
+    }
+
+    // 返回的引用在下一次insert之前有效
+    Entry &insert(int fd, Channel *channel) {
+        if (static_cast<size_t>(fd) >= entries_.size()) {
+            entries_.resize(std::max(static_cast<size_t>(fd) + 1, entries_.size() * 2));
+        }
+        Entry &entry = entries_[fd];
+        if (entry.channel == nullptr) {
+            ++size_;
+        }
+        entry.channel = channel;
+        return entry;
+    }
+
+    void erase(int fd) {
+        Entry *entry = find(fd);
+        if (entry != nullptr) {
+            *entry = Entry();
+            --size_;
+        }
+    }
+
+    size_t size() const { return size_; }
+
+private:
+    std::vector<Entry> entries_;
+    size_t size_;
+};
+
 // 多路事件分发器的核心IO复用模块
 class Poller : nocopyable {
 public:
@@ -25,12 +75,14 @@ public:
     bool hasChannel(Channel *channel) const;
 
     // EventLoop可以通过该接口获取默认的IO复用的具体实现
+    // 设置了环境变量LITENET_USE_IOURING时使用io_uring，否则使用epoll
     static Poller *newDefaultPoller(EventLoop *loop);
+    // 指定IO复用的实现，io_uring不可用时回退到epoll
+    static Poller *newPoller(EventLoop *loop, EventLoop::Backend backend);
 
 protected:
-    // key: sockfd, value: sockfd所属的通道类型
-    using ChannelMap = std::unordered_map<int, Channel *>;
-    ChannelMap channels_;
+    // 下标: sockfd, 表项: sockfd所属的通道和注册状态
+    ChannelTable channels_;
 
 private:
     EventLoop *owenrLoop_;
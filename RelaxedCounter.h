@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+// 库内部的统计计数辅助函数，不属于对外接口
+
+// 计数只由所属的loop线程修改，不需要原子的读-改-写
+inline void addRelaxed(std::atomic<uint64_t> &counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
@@ -0,0 +1,115 @@
+#include "Slab.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <new>
+
+#include "Logger.h"
+
+namespace {
+
+// 槽位按照malloc的对齐要求取整
+const size_t kSlotAlign = 16;
+
+size_t slotSizeFor(size_t size) {
+    return (size + kSlotAlign - 1) & ~(kSlotAlign - 1);
+}
+
+}  // namespace
+
+Slab::Slab(size_t objectsPerBlock)
+    : objectsPerBlock_(objectsPerBlock), objectSize_(0), emptyBlock_(nullptr), numAllocated_(0) {}
+
+Slab::~Slab() {
+    for (auto &item : blocks_) {
+        ::free(item.first);
+    }
+}
+
+void *Slab::allocate(size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (objectSize_ == 0) {
+        objectSize_ = slotSizeFor(std::max(size, sizeof(FreeSlot)));
+    }
+    if (slotSizeFor(size) != objectSize_) {
+        return ::operator new(size);
+    }
+    if (available_.empty()) {
+        grow();
+    }
+    char *start = *available_.begin();
+    Block &block = blocks_[start];
+    FreeSlot *slot = block.freeList;
+    block.freeList = slot->next;
+    if (block.freeList == nullptr) {
+        available_.erase(start);
+    }
+    if (block.used++ == 0 && start == emptyBlock_) {
+        emptyBlock_ = nullptr;
+    }
+    ++numAllocated_;
+    return slot;
+}
+
+void Slab::deallocate(void *ptr, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (slotSizeFor(size) != objectSize_) {
+        ::operator delete(ptr);
+        return;
+    }
+    // 起始地址不大于ptr的最后一块
+    auto it = --blocks_.upper_bound(static_cast<char *>(ptr));
+    char *start = it->first;
+    Block &block = it->second;
+    FreeSlot *slot = static_cast<FreeSlot *>(ptr);
+    if (block.freeList == nullptr) {
+        available_.insert(start);
+    }
+    slot->next = block.freeList;
+    block.freeList = slot;
+    --numAllocated_;
+    if (--block.used > 0) {
+        return;
+    }
+    if (emptyBlock_ == nullptr) {
+        emptyBlock_ = start;
+    } else {
+        available_.erase(start);
+        blocks_.erase(it);
+        ::free(start);
+    }
+}
+
+// 在锁中调用
+void Slab::grow() {
+    char *start = static_cast<char *>(::malloc(objectSize_ * objectsPerBlock_));
+    if (start == nullptr) {
+        LOG_FATAL("Slab::malloc %zu bytes failed\n", objectSize_ * objectsPerBlock_);
+    }
+    Block &block = blocks_[start];
+    block.freeList = nullptr;
+    block.used = 0;
+    // 倒着压入，分配的顺序和地址的顺序一致
+    for (size_t i = objectsPerBlock_; i > 0; --i) {
+        FreeSlot *slot = reinterpret_cast<FreeSlot *>(start + (i - 1) * objectSize_);
+        slot->next = block.freeList;
+        block.freeList = slot;
+    }
+    available_.insert(start);
+}
+
+size_t Slab::objectSize() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return objectSize_;
+}
+
+size_t Slab::numBlocks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return blocks_.size();
+}
+
+size_t Slab::numAllocated() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return numAllocated_;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+
+#include "nocopyable.h"
+
+/**
+ * 固定大小对象的slab分配器，一次向malloc申请一整块内存，切成多个槽位，释放的槽位放回空闲链表
+ * 每个EventLoop一个，用来分配连接对象(连同shared_ptr的控制块)，同一个loop的连接在内存中相邻
+ * 连接可能在接受连接的线程中创建，在任意线程中释放最后一个引用，分配和释放都加锁
+ * 优先从地址最低的块分配，高地址的块更容易整块空出来；一块的槽位全部空闲时把它还给malloc，
+ * 最多保留一个空闲的块，避免连接数在块的边界附近波动时反复申请和释放
+ * slab由SlabAllocator的副本共同持有，比最后一个对象活得更久，析构时释放剩下的块
+ */
+class Slab : nocopyable {
+public:
+    explicit Slab(size_t objectsPerBlock = 64);
+    ~Slab();
+
+    // 第一次分配时确定槽位的大小，之后大小不同的请求直接使用operator new
+    void *allocate(size_t size);
+    // size必须和allocate时相同
+    void deallocate(void *ptr, size_t size);
+
+    // 统计信息
+    size_t objectSize() const;
+    size_t numBlocks() const;
+    size_t numAllocated() const;
+
+private:
+    // 空闲的槽位，链表指针直接存放在槽位的开头
+    struct FreeSlot {
+        FreeSlot *next;
+    };
+    // 每块各自的空闲链表，用来判断这块是否全部空闲
+    struct Block {
+        FreeSlot *freeList;
+        size_t used;
+    };
+
+    void grow();
+
+    mutable std::mutex mutex_;
+    const size_t objectsPerBlock_;
+    size_t objectSize_;
+    std::map<char *, Block> blocks_;  // 块的起始地址 -> 块，释放时按地址找到槽位所在的块
+    std::set<char *> available_;      // 还有空闲槽位的块
+    char *emptyBlock_;                // 保留的全部空闲的块
+    size_t numAllocated_;
+};
+
+using SlabPtr = std::shared_ptr<Slab>;
+
+// 从Slab分配内存的分配器，用于std::allocate_shared，对象和控制块在同一个槽位中
+template <typename T>
+class SlabAllocator {
+public:
+    using value_type = T;
+
+    explicit SlabAllocator(SlabPtr slab) : slab_(std::move(slab)) {}
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U> &other) : slab_(other.slab()) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(slab_->allocate(n * sizeof(T))); }
+    void deallocate(T *ptr, size_t n) { slab_->deallocate(ptr, n * sizeof(T)); }
+
+    const SlabPtr &slab() const { return slab_; }
+
+private:
+    SlabPtr slab_;
+};
+
+template <typename T, typename U>
+bool operator==(const SlabAllocator<T> &lhs, const SlabAllocator<U> &rhs) {
+    return lhs.slab() == rhs.slab();
+}
+
+template <typename T, typename U>
+bool operator!=(const SlabAllocator<T> &lhs, const SlabAllocator<U> &rhs) {
+    return !(lhs == rhs);
+}
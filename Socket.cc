@@ -1,5 +1,7 @@
 #include "Socket.h"
 
+#include <errno.h>
+#include <linux/filter.h>
 #include <netinet/tcp.h>
 #include <string.h>
 #include <sys/socket.h>
@@ -56,11 +58,47 @@ void Socket::setReuseAddr(bool on) {
 
 void Socket::setReusePort(bool on) {
     int optval = on ? 1 : 0;
-    ::setsockopt(sockfd_, SOL_SOCKET, SO_REUSEADDR,
-                 &optval, static_cast<socklen_t>(sizeof(optval)));
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_REUSEPORT,
+                     &optval, static_cast<socklen_t>(sizeof(optval))) < 0 && on) {
+        LOG_ERROR("SO_REUSEPORT failed, errno=%d", errno);
+    }
 }
+
 void Socket::setKeepAlive(bool on) {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE,
                  &optval, static_cast<socklen_t>(sizeof(optval)));
-}
\ No newline at end of file
+}
+
+void Socket::setTcpNotSentLowat(unsigned int bytes) {
+    if (::setsockopt(sockfd_, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+                     &bytes, static_cast<socklen_t>(sizeof(bytes))) < 0) {
+        LOG_ERROR("TCP_NOTSENT_LOWAT failed, errno=%d", errno);
+    }
+}
+
+bool Socket::attachReusePortCpuProgram(const std::vector<int> &indexOfCpu) {
+    // A = 当前cpu; 对每个cpu: if (A == cpu) return index; 最后返回越界的下标，内核回退到哈希
+    std::vector<sock_filter> code;
+    code.push_back(sock_filter{BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)});
+    for (size_t cpu = 0; cpu < indexOfCpu.size(); ++cpu) {
+        if (indexOfCpu[cpu] >= 0) {
+            code.push_back(sock_filter{BPF_JMP | BPF_JEQ | BPF_K, 0, 1, static_cast<uint32_t>(cpu)});
+            code.push_back(sock_filter{BPF_RET | BPF_K, 0, 0, static_cast<uint32_t>(indexOfCpu[cpu])});
+        }
+    }
+    code.push_back(sock_filter{BPF_RET | BPF_K, 0, 0, 0xffffffff});
+    if (code.size() > BPF_MAXINSNS) {
+        LOG_ERROR("SO_ATTACH_REUSEPORT_CBPF too many cpus: %lu\n", indexOfCpu.size());
+        return false;
+    }
+
+    sock_fprog prog;
+    prog.len = static_cast<unsigned short>(code.size());
+    prog.filter = code.data();
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+        LOG_ERROR("SO_ATTACH_REUSEPORT_CBPF failed, errno=%d\n", errno);
+        return false;
+    }
+    return true;
+}
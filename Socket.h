@@ -1,4 +1,6 @@
 #pragma once 
+#include <vector>
+
 #include "nocopyable.h"
 
 class InetAddress;
@@ -20,6 +22,11 @@ public:
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+    // 发送缓冲区中还没发出去的数据少于bytes字节时socket才可写
+    void setTcpNotSentLowat(unsigned int bytes);
+    // 给SO_REUSEPORT监听组挂载classic BPF程序，按照处理数据包的cpu选择监听socket
+    // indexOfCpu[cpu]为组内socket的下标(按listen的顺序)，-1表示交给内核按哈希选择
+    bool attachReusePortCpuProgram(const std::vector<int> &indexOfCpu);
 
 private:
     const int sockfd_;
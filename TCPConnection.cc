@@ -1,99 +1,492 @@
 #include "TCPConnection.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include "Channel.h"
 #include "EventLoop.h"
 #include "Logger.h"
+#include "RelaxedCounter.h"
 #include "Socket.h"
 
+namespace {
+
+// 没有设置回调表的连接共用的空表
+const ConnectionCallbacksPtr &emptyCallbacks() {
+    static const ConnectionCallbacksPtr callbacks = std::make_shared<ConnectionCallbacks>();
+    return callbacks;
+}
+
+}  // namespace
+
+const size_t TCPConnection::kDefaultHighWaterMark;
+
 TCPConnection::TCPConnection(EventLoop *loop,
-                             const std::string &nameArg,
+                             uint64_t id,
+                             const std::shared_ptr<const std::string> &namePrefix,
                              int sockfd,
                              const InetAddress &localAddr,
                              const InetAddress &peerAddr)
-    : loop_(loop), name_(nameArg), state_(kConnecting), reading_(true), socket_(new Socket(sockfd))
-    , channel_(new Channel(loop, sockfd)), localAddr_(localAddr), peerAddr_(peerAddr), highWaterMark_(64 * 1024 * 1024) {
+    : loop_(loop), id_(id), namePrefix_(namePrefix), state_(kConnecting), reading_(true), readPaused_(false), socket_(sockfd)
+    , channel_(loop, sockfd), localAddr_(localAddr), peerAddr_(peerAddr), callbacks_(emptyCallbacks())
+    , highWaterMark_(kDefaultHighWaterMark), flowHighMark_(0), flowLowMark_(0)
+    , inputBuffer_(loop->bufferPool()), reportedPendingBytes_(0)
+    , idleTimeout_(0.0), writeStallTimeout_(0.0), idleTicks_(0), writeStallTicks_(0), lastActiveTick_(0), lastDrainTick_(0)
+    , timeoutEntry_(std::bind(&TCPConnection::handleTimeout, this))
+    , bytesReceived_(0), bytesSent_(0), eventsHandled_(0)
+    , queueLoop_(loop), migrating_(false), migrateTarget_(nullptr), destroyed_(false) {
     // 给channel设置相应的回调函数，Poller通知Channel感兴趣的事件发生了，Channel会回调相应的操作
-    channel_->setReadCallback(std::bind(&TCPConnection::handleRead, this, std::placeholders::_1));
-    channel_->setWriteCallback(std::bind(&TCPConnection::handleWrite, this));
-    channel_->setCloseCallback(std::bind(&TCPConnection::handleClose, this));
-    channel_->setErrorCallback(std::bind(&TCPConnection::handleError, this));
+    channel_.setReadCallback(std::bind(&TCPConnection::handleRead, this, std::placeholders::_1));
+    channel_.setWriteCallback(std::bind(&TCPConnection::handleWrite, this));
+    channel_.setCloseCallback(std::bind(&TCPConnection::handleClose, this));
+    channel_.setErrorCallback(std::bind(&TCPConnection::handleError, this));
 
-    LOG_INFO("TCPConnection::ctor[%s] at fd = %d\n", name_.c_str(), sockfd);
-    socket_->setKeepAlive(true);
+    LOG_INFO("TCPConnection::ctor[%s#%llu] at fd = %d\n", namePrefix_ ? namePrefix_->c_str() : "",
+             static_cast<unsigned long long>(id_), sockfd);
+    // 在connectDestoryed中减去
+    getLoop()->addConnections(1);
+}
+
+const std::string &TCPConnection::name() const {
+    // 大部分连接只有打日志时才需要名字，不在创建连接时拼接字符串
+    std::call_once(nameOnce_, [this] {
+        name_ = namePrefix_ ? *namePrefix_ : std::string();
+        name_ += '#';
+        name_ += std::to_string(id_);
+    });
+    return name_;
+}
+
+const InetAddress &TCPConnection::localAddress() const {
+    std::call_once(localAddrOnce_, [this] {
+        const sockaddr_in *addr = localAddr_.getSockAddr();
+        if (addr->sin_addr.s_addr != htonl(INADDR_ANY) && addr->sin_port != 0) {
+            return;
+        }
+        sockaddr_in local;
+        ::bzero(&local, sizeof(local));
+        socklen_t addrlen = static_cast<socklen_t>(sizeof(local));
+        if (::getsockname(socket_.fd(), (struct sockaddr *)&local, &addrlen) < 0) {
+            LOG_ERROR("TCPConnection::localAddress getsockname error:%d\n", errno);
+            return;
+        }
+        localAddr_.setSockAddr(local);
+    });
+    return localAddr_;
+}
+
+ConnectionCallbacks &TCPConnection::mutableCallbacks() {
+    std::shared_ptr<ConnectionCallbacks> callbacks = std::make_shared<ConnectionCallbacks>(*callbacks_);
+    callbacks_ = callbacks;
+    return *callbacks;
 }
 
 TCPConnection::~TCPConnection() {
-    LOG_DEBUG("TCPConnection::dtor[%s] at fd = %d, state = %d\n", name_.c_str(), channel_->fd(), int(state_));
+    LOG_DEBUG("TCPConnection::dtor[%s] at fd = %d, state = %d\n", name().c_str(), channel_.fd(), int(state_));
 }
 
 void TCPConnection::send(const std::string &buf) {
     if (state_ == kConnected) {
-        if (loop_->isInLoopThread()) {
-            sendInLoop(buf.c_str(), buf.length());
+        if (isOwnerThread()) {
+            sendInLoop(buf.data(), buf.size());
         } else {
-            loop_->runInLoop(std::bind(
-                &TCPConnection::sendInLoop,
-                this,
-                buf.c_str(),
-                buf.size()));
+            // 调用者的buf可能在loop执行之前就被释放了，必须拷贝一份
+            send(std::string(buf));
         }
     }
 }
 
-void TCPConnection::sendInLoop(const void *data, size_t len) {
-    ssize_t nwrote = 0;
-    size_t remaining = len;
-    bool faultError = false;
+void TCPConnection::send(std::string &&buf) {
+    if (state_ == kConnected) {
+        if (isOwnerThread()) {
+            sendStringInLoop(buf);
+        } else {
+            queueToLoop(std::bind(
+                &TCPConnection::sendStringInLoop,
+                shared_from_this(),
+                std::move(buf)));
+        }
+    }
+}
+
+void TCPConnection::send(const void *data, size_t len) {
+    if (state_ == kConnected) {
+        if (isOwnerThread()) {
+            sendInLoop(data, len);
+        } else {
+            send(std::string(static_cast<const char *>(data), len));
+        }
+    }
+}
+
+void TCPConnection::send(Buffer *buf) {
+    if (state_ == kConnected) {
+        if (isOwnerThread()) {
+            sendInLoop(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        } else {
+            Buffer data;
+            data.swap(*buf);
+            queueToLoop(std::bind(
+                &TCPConnection::sendBufferInLoop,
+                shared_from_this(),
+                std::move(data)));
+        }
+    }
+}
+
+void TCPConnection::send(const std::shared_ptr<const std::string> &data) {
+    if (state_ == kConnected) {
+        if (isOwnerThread()) {
+            sendSharedInLoop(data);
+        } else {
+            queueToLoop(std::bind(
+                &TCPConnection::sendSharedInLoop,
+                shared_from_this(),
+                data));
+        }
+    }
+}
+
+void TCPConnection::send(std::vector<std::string> &&pieces) {
+    if (state_ == kConnected) {
+        if (isOwnerThread()) {
+            sendPiecesInLoop(pieces);
+        } else {
+            queueToLoop(std::bind(
+                &TCPConnection::sendPiecesInLoop,
+                shared_from_this(),
+                std::move(pieces)));
+        }
+    }
+}
 
+void TCPConnection::sendInLoop(const void *data, size_t len) {
     // 之前调用过connection的shutdown，不能在发送数据了
     if (state_ == kDisconnected) {
         LOG_ERROR("disconnected, give up writing!");
         return;
     }
 
-    // channel第一次发送数据，并且缓冲区没有数据
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
-        nwrote = ::write(channel_->fd(), data, len);
-        if (nwrote >= 0) {
-            remaining = len - nwrote;
-            if (remaining == 0 && writeCompleteCallback_) {
-                // 
-                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
-            }
-        } else { // nwrote < 0
-            nwrote = 0;
-            if (errno != EWOULDBLOCK) {
-                LOG_ERROR("TCPConnection::sendInLoop");
-                if (errno == EPIPE || errno == ECONNRESET) {
-                    faultError = true;
-                }
-            }
+    ssize_t nwrote = writeDirectly(data, len);
+    if (nwrote < 0) {
+        return;
+    }
+
+    // 当前这一次write，没有将数据全部发送出去，剩余数据需要保存到发送队列中
+    size_t remaining = len - nwrote;
+    if (remaining > 0) {
+        size_t oldLen = outputBuffer_.readableBytes();
+        outputBuffer_.append(static_cast<const char *>(data) + nwrote, remaining);
+        outputQueued(oldLen);
+    }
+}
+
+// 数据的所有权已经在loop线程中，剩余没有发送的部分直接挂到发送队列上，不再拷贝
+void TCPConnection::sendStringInLoop(std::string &message) {
+    if (!isOwnerThread()) {
+        forwardToOwner(std::bind(&TCPConnection::sendStringInLoop, shared_from_this(), std::move(message)));
+        return;
+    }
+    if (state_ == kDisconnected) {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+
+    ssize_t nwrote = writeDirectly(message.data(), message.size());
+    if (nwrote < 0 || static_cast<size_t>(nwrote) == message.size()) {
+        return;
+    }
+
+    size_t oldLen = outputBuffer_.readableBytes();
+    outputBuffer_.append(std::move(message));
+    // 直接写只会发生在队列为空的时候，已经写出去的部分就是队列的头部
+    outputBuffer_.retrieve(nwrote);
+    outputQueued(oldLen);
+}
+
+void TCPConnection::sendBufferInLoop(Buffer &buf) {
+    if (!isOwnerThread()) {
+        forwardToOwner(std::bind(&TCPConnection::sendBufferInLoop, shared_from_this(), std::move(buf)));
+        return;
+    }
+    if (state_ == kDisconnected) {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+
+    ssize_t nwrote = writeDirectly(buf.peek(), buf.readableBytes());
+    if (nwrote < 0 || static_cast<size_t>(nwrote) == buf.readableBytes()) {
+        return;
+    }
+
+    size_t oldLen = outputBuffer_.readableBytes();
+    buf.retrieve(nwrote);
+    outputBuffer_.append(std::move(buf));
+    outputQueued(oldLen);
+}
+
+void TCPConnection::sendSharedInLoop(const std::shared_ptr<const std::string> &data) {
+    if (!isOwnerThread()) {
+        forwardToOwner(std::bind(&TCPConnection::sendSharedInLoop, shared_from_this(), data));
+        return;
+    }
+    if (state_ == kDisconnected) {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+
+    ssize_t nwrote = writeDirectly(data->data(), data->size());
+    if (nwrote < 0 || static_cast<size_t>(nwrote) == data->size()) {
+        return;
+    }
+
+    size_t oldLen = outputBuffer_.readableBytes();
+    outputBuffer_.append(data, data->data() + nwrote, data->size() - nwrote);
+    outputQueued(oldLen);
+}
+
+// 多个数据段一起放入发送队列，队列原本为空时立即通过一次writev发送
+void TCPConnection::sendPiecesInLoop(std::vector<std::string> &pieces) {
+    if (!isOwnerThread()) {
+        forwardToOwner(std::bind(&TCPConnection::sendPiecesInLoop, shared_from_this(), std::move(pieces)));
+        return;
+    }
+    if (state_ == kDisconnected) {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+
+    size_t oldLen = outputBuffer_.readableBytes();
+    bool idle = !channel_.isWriting() && oldLen == 0;
+    for (std::string &piece : pieces) {
+        outputBuffer_.append(std::move(piece));
+    }
+
+    flushIfIdle(idle);
+    outputQueued(oldLen);
+}
+
+void TCPConnection::sendFile(int fd, off_t offset, size_t length) {
+    if (state_ != kConnected || length == 0) {
+        return;
+    }
+    int dupFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dupFd < 0) {
+        LOG_ERROR("TCPConnection::sendFile dup fd=%d failed, errno=%d", fd, errno);
+        return;
+    }
+
+    OutputQueue::FileHandle file = OutputQueue::makeFileHandle(dupFd);
+    if (isOwnerThread()) {
+        sendFileInLoop(file, offset, length);
+    } else {
+        queueToLoop(std::bind(
+            &TCPConnection::sendFileInLoop,
+            shared_from_this(),
+            file,
+            offset,
+            length));
+    }
+}
+
+void TCPConnection::sendFileInLoop(const OutputQueue::FileHandle &file, off_t offset, size_t length) {
+    if (!isOwnerThread()) {
+        forwardToOwner(std::bind(&TCPConnection::sendFileInLoop, shared_from_this(), file, offset, length));
+        return;
+    }
+    if (state_ == kDisconnected) {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+
+    size_t oldLen = outputBuffer_.readableBytes();
+    bool idle = !channel_.isWriting() && oldLen == 0;
+    outputBuffer_.appendFile(file, offset, length);
+    flushIfIdle(idle);
+    outputQueued(oldLen);
+}
+
+void TCPConnection::sendStream(const StreamProducer &producer) {
+    if (state_ == kConnected) {
+        if (isOwnerThread()) {
+            sendStreamInLoop(producer);
+        } else {
+            queueToLoop(std::bind(
+                &TCPConnection::sendStreamInLoop,
+                shared_from_this(),
+                producer));
         }
-    } 
+    }
+}
+
+void TCPConnection::sendStreamInLoop(const StreamProducer &producer) {
+    if (!isOwnerThread()) {
+        forwardToOwner(std::bind(&TCPConnection::sendStreamInLoop, shared_from_this(), producer));
+        return;
+    }
+    if (state_ == kDisconnected) {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+    if (producer_) {
+        LOG_ERROR("TCPConnection::sendStream [%s] - previous stream not finished\n", name().c_str());
+        return;
+    }
 
-    // 当前这一次write，没有将数据全部发送出去，剩余数据需要保存到缓冲区中
-    // channel注册epollout事件，poller发送tcp的发送缓冲区有空间
-    // 会通知相应的sock channel，调用handleWrite回调方法
-    // 即调用TCPConnection::handleWrite方法，把发送缓冲区数据全部发送完成
-    if (!faultError && remaining > 0) {
+    producer_.reset(new StreamProducer(producer));
+    resumeStreamInLoop();
+}
+
+void TCPConnection::resumeStream() {
+    if (isOwnerThread()) {
+        resumeStreamInLoop();
+    } else {
+        queueToLoop(std::bind(&TCPConnection::resumeStreamInLoop, shared_from_this()));
+    }
+}
+
+void TCPConnection::resumeStreamInLoop() {
+    if (!isOwnerThread()) {
+        forwardToOwner(std::bind(&TCPConnection::resumeStreamInLoop, shared_from_this()));
+        return;
+    }
+    if (state_ == kDisconnected || !producer_) {
+        return;
+    }
+    if (!channel_.isWriting()) {
+        // 发送队列为空，直接开始拉取数据，边缘触发模式下EPOLLOUT一直注册着，不会再有新的通知
+        channel_.enableWriting();
+        handleWrite();
+    }
+}
+
+size_t TCPConnection::pullStream() {
+    Buffer chunk;
+    bool more = (*producer_)(shared_from_this(), &chunk);
+    if (!more) {
+        producer_.reset();
+    }
+    size_t len = chunk.readableBytes();
+    if (len > 0) {
         size_t oldLen = outputBuffer_.readableBytes();
-        if (oldLen + remaining >= highWaterMark_
-            && oldLen < highWaterMark_
-            && highWaterMarkCallback_) {
-            loop_->queueInLoop(
-                std::bind(highWaterMarkCallback_, shared_from_this(), oldLen - remaining)
-            );
+        outputBuffer_.append(std::move(chunk));
+        outputQueued(oldLen);
+    }
+    return len;
+}
+
+// 数据刚放入原本为空的发送队列，立即尝试发送一次
+void TCPConnection::flushIfIdle(bool idle) {
+    if (!idle || outputBuffer_.empty()) {
+        return;
+    }
+    int saveErrno = 0;
+    ssize_t n = 0;
+    // 一次writev最多IOV_MAX个数据段，遇到文件数据段也会停下，边缘触发模式下没有EAGAIN就不会再有EPOLLOUT
+    // 和handleWrite一样写到队列为空或者EAGAIN
+    do {
+        n = outputBuffer_.writeFd(channel_.fd(), &saveErrno);
+        if (n <= 0) {
+            break;
+        }
+        addRelaxed(bytesSent_, n);
+        if (timeoutEnabled()) {
+            lastActiveTick_ = getLoop()->timingWheel()->now();
         }
-        outputBuffer_.append((char*)data + nwrote, remaining);
-        if (!channel_->isWriting()) {
-            // 注册channel的写事件
-            channel_->enableWriting();
+        outputBuffer_.retrieve(n);
+    } while (channel_.isEdgeTriggered() && !outputBuffer_.empty());
+
+    if (n >= 0) {
+        if (outputBuffer_.empty() && callbacks_->writeComplete) {
+            getLoop()->queueInLoop(std::bind(callbacks_->writeComplete, shared_from_this()));
         }
+    } else if (saveErrno != EWOULDBLOCK) {
+        LOG_ERROR("TCPConnection::flushIfIdle errno=%d", saveErrno);
+        if (saveErrno == EPIPE || saveErrno == ECONNRESET) {
+            outputBuffer_.retrieveAll();
+        } else if (saveErrno == EIO) {
+            // 文件比声明的长度短，对端收到的数据已经不完整了
+            outputBuffer_.retrieveAll();
+            forceCloseInLoop();
+        }
+    }
+}
+
+// channel没有在写，并且发送队列为空时，直接写socket
+// 返回写入的字节数，发生EPIPE/ECONNRESET等错误时返回-1，剩余的数据不需要再发送
+ssize_t TCPConnection::writeDirectly(const void *data, size_t len) {
+    if (channel_.isWriting() || outputBuffer_.readableBytes() > 0) {
+        return 0;
+    }
+
+    ssize_t nwrote = ::write(channel_.fd(), data, len);
+    if (nwrote >= 0) {
+        addRelaxed(bytesSent_, nwrote);
+        if (timeoutEnabled()) {
+            lastActiveTick_ = getLoop()->timingWheel()->now();
+        }
+        if (static_cast<size_t>(nwrote) == len && callbacks_->writeComplete) {
+            getLoop()->queueInLoop(std::bind(callbacks_->writeComplete, shared_from_this()));
+        }
+        return nwrote;
+    }
+
+    if (errno != EWOULDBLOCK) {
+        LOG_ERROR("TCPConnection::sendInLoop");
+        if (errno == EPIPE || errno == ECONNRESET) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 有数据放入了发送队列，oldLen为放入之前队列中的字节数
+// channel注册epollout事件，poller发现tcp的发送缓冲区有空间
+// 会通知相应的sock channel，调用handleWrite回调方法，把发送队列的数据全部发送完成
+void TCPConnection::outputQueued(size_t oldLen) {
+    reportPendingBytes();
+    size_t newLen = outputBuffer_.readableBytes();
+    if (newLen == oldLen) {
+        return;
+    }
+
+    if (newLen >= highWaterMark_
+        && oldLen < highWaterMark_
+        && callbacks_->highWaterMark) {
+        getLoop()->queueInLoop(
+            std::bind(callbacks_->highWaterMark, shared_from_this(), newLen)
+        );
+    }
+    if (flowHighMark_ > 0 && newLen >= flowHighMark_ && !readPaused_) {
+        // 发送跟不上，先不读新的数据，等handleWrite把队列降到低水位以下
+        readPaused_ = true;
+        updateReading();
+    }
+    if (oldLen == 0 && writeStallTicks_ > 0) {
+        // 发送队列开始积压数据，从现在开始计算写超时
+        lastDrainTick_ = getLoop()->timingWheel()->now();
+        scheduleTimeout();
+    }
+    if (!channel_.isWriting()) {
+        // 注册channel的写事件
+        channel_.enableWriting();
+    }
+}
+
+void TCPConnection::reportPendingBytes() {
+    size_t pending = outputBuffer_.readableBytes();
+    if (pending != reportedPendingBytes_) {
+        getLoop()->addPendingBytes(static_cast<int64_t>(pending) - static_cast<int64_t>(reportedPendingBytes_));
+        reportedPendingBytes_ = pending;
     }
 }
 
@@ -101,42 +494,272 @@ void TCPConnection::sendInLoop(const void *data, size_t len) {
 void TCPConnection::shutdown() {
     if (state_ == kConnected) {
         setState(kDisconnecting);
-        loop_->runInLoop(std::bind(&TCPConnection::shutdownInLoop, this));
+        if (isOwnerThread()) {
+            shutdownInLoop();
+        } else {
+            queueToLoop(std::bind(&TCPConnection::shutdownInLoop, shared_from_this()));
+        }
     }
 }
 
 void TCPConnection::shutdownInLoop() {
-    if (!channel_->isWriting()) {
-        socket_->shutdownWrite();
+    if (!isOwnerThread()) {
+        forwardToOwner(std::bind(&TCPConnection::shutdownInLoop, shared_from_this()));
+        return;
+    }
+    // 暂停的流还没有结束，等流发送完之后在handleWrite中关闭
+    if (!channel_.isWriting() && !producer_) {
+        socket_.shutdownWrite();
+    }
+}
+
+void TCPConnection::forceClose() {
+    if (state_ == kConnected || state_ == kDisconnecting) {
+        setState(kDisconnecting);
+        queueToLoop(std::bind(&TCPConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TCPConnection::forceCloseInLoop() {
+    if (!isOwnerThread()) {
+        forwardToOwner(std::bind(&TCPConnection::forceCloseInLoop, shared_from_this()));
+        return;
+    }
+    if (state_ == kConnected || state_ == kDisconnecting) {
+        handleClose();
+    }
+}
+
+void TCPConnection::startRead() {
+    if (isOwnerThread()) {
+        startReadInLoop();
+    } else {
+        queueToLoop(std::bind(&TCPConnection::startReadInLoop, shared_from_this()));
+    }
+}
+
+void TCPConnection::startReadInLoop() {
+    if (!isOwnerThread()) {
+        forwardToOwner(std::bind(&TCPConnection::startReadInLoop, shared_from_this()));
+        return;
+    }
+    reading_ = true;
+    updateReading();
+}
+
+void TCPConnection::stopRead() {
+    if (isOwnerThread()) {
+        stopReadInLoop();
+    } else {
+        queueToLoop(std::bind(&TCPConnection::stopReadInLoop, shared_from_this()));
+    }
+}
+
+void TCPConnection::stopReadInLoop() {
+    if (!isOwnerThread()) {
+        forwardToOwner(std::bind(&TCPConnection::stopReadInLoop, shared_from_this()));
+        return;
+    }
+    reading_ = false;
+    updateReading();
+}
+
+void TCPConnection::updateReading() {
+    if (state_ != kConnected && state_ != kDisconnecting) {
+        return;
     }
+    bool wanted = reading_ && !readPaused_;
+    if (wanted == channel_.isReading()) {
+        return;
+    }
+    if (wanted) {
+        channel_.enableReading();
+        if (channel_.isEdgeTriggered()) {
+            // 暂停期间到达的数据不会再产生新的边缘，主动读一次
+            queueToLoop(std::bind(&TCPConnection::handleRead, shared_from_this(), Timestamp::now()));
+        }
+    } else {
+        channel_.disableReading();
+    }
+}
+
+bool TCPConnection::isOwnerThread() const {
+    // 迁移过程中新loop要等到migrateEstablished之后才拥有连接
+    if (migrating_.load(std::memory_order_acquire) && migrateTarget_.load(std::memory_order_relaxed)->isInLoopThread()) {
+        return false;
+    }
+    return getLoop()->isInLoopThread();
+}
+
+void TCPConnection::queueToLoop(EventLoop::Functor cb) {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    queueLoop_->queueInLoop(std::move(cb));
+}
+
+void TCPConnection::forwardToOwner(EventLoop::Functor cb) {
+    if (migrating_.load(std::memory_order_acquire) && migrateTarget_.load(std::memory_order_relaxed)->isInLoopThread()) {
+        // 迁移完成之后按照收到的顺序执行
+        deferred_.push_back(std::move(cb));
+    } else {
+        // 原loop中迁移之后才执行的操作
+        queueToLoop(std::move(cb));
+    }
+}
+
+void TCPConnection::migrate(EventLoop *target) {
+    // 总是放到队列中执行，不能在channel的回调中销毁channel
+    queueToLoop(std::bind(&TCPConnection::migrateInLoop, shared_from_this(), target));
+}
+
+void TCPConnection::migrateInLoop(EventLoop *target) {
+    if (!isOwnerThread()) {
+        forwardToOwner(std::bind(&TCPConnection::migrateInLoop, shared_from_this(), target));
+        return;
+    }
+    if (state_ != kConnected || migrating_ || target == getLoop()) {
+        return;
+    }
+
+    migrateTarget_.store(target, std::memory_order_relaxed);
+    migrating_.store(true, std::memory_order_release);
+    {
+        // 之后其他线程的操作都投递到新的loop，在那里等待迁移完成
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        queueLoop_ = target;
+    }
+    // 排在之前投递到原loop的所有操作之后，这些操作仍然在原loop中执行
+    getLoop()->queueInLoop(std::bind(&TCPConnection::handoffInLoop, shared_from_this()));
+}
+
+void TCPConnection::handoffInLoop() {
+    EventLoop *source = getLoop();
+    EventLoop *target = migrateTarget_.load(std::memory_order_relaxed);
+    bool reading = channel_.isReading();
+    bool writing = channel_.isWriting();
+    if (!destroyed_) {
+        if (timeoutEntry_.linked()) {
+            source->timingWheel()->cancel(&timeoutEntry_);
+        }
+        channel_.disableAll();
+        channel_.remove();
+        source->addConnections(-1);
+        source->addPendingBytes(-static_cast<int64_t>(reportedPendingBytes_));
+        target->addConnections(1);
+        target->addPendingBytes(static_cast<int64_t>(reportedPendingBytes_));
+    }
+    // 原来的pool只能在原loop中使用，没处理完的数据先留在自己的内存中，到新loop之后再换成新loop的pool
+    inputBuffer_.setPool(nullptr);
+    // channel已经从原loop中删除，换到新的loop，在新loop中重新注册
+    channel_.setOwnerLoop(target);
+
+    loop_.store(target, std::memory_order_release);
+    target->queueInLoop(std::bind(&TCPConnection::migrateEstablished, shared_from_this(), reading, writing));
+}
+
+// socket中已经到达的数据在重新注册之后会马上通知，没有处理的数据还在inputBuffer_中
+void TCPConnection::migrateEstablished(bool reading, bool writing) {
+    channel_.tie(shared_from_this());
+    if (!destroyed_) {
+        inputBuffer_.setPool(getLoop()->bufferPool());
+        if (reading) {
+            channel_.enableReading();
+        }
+        if (writing) {
+            channel_.enableWriting();
+        }
+        if (state_ == kConnected || state_ == kDisconnecting) {
+            startTimeout();
+        }
+    }
+
+    migrating_.store(false, std::memory_order_release);
+    std::vector<EventLoop::Functor> deferred;
+    deferred.swap(deferred_);
+    for (EventLoop::Functor &cb : deferred) {
+        cb();
+    }
+}
+
+void TCPConnection::setEdgeTriggered(bool on) {
+    channel_.setEdgeTriggered(on);
 }
 
 // 连接建立
 void TCPConnection::connectEstablished() {
     setState(kConnected);
-    channel_->tie(shared_from_this());
-    channel_->enableReading(); // 向poller注册channel的epollin事件
+    channel_.tie(shared_from_this());
+    channel_.enableReading(); // 向poller注册channel的epollin事件
+    startTimeout();
 
-    connectionCallback_(shared_from_this());
+    callbacks_->connection(shared_from_this());
+}
+
+void TCPConnection::startTimeout() {
+    if (idleTimeout_ > 0.0 || writeStallTimeout_ > 0.0) {
+        TimingWheel *wheel = getLoop()->timingWheel();
+        idleTicks_ = idleTimeout_ > 0.0 ? wheel->ticksFor(idleTimeout_) : 0;
+        writeStallTicks_ = writeStallTimeout_ > 0.0 ? wheel->ticksFor(writeStallTimeout_) : 0;
+        lastActiveTick_ = lastDrainTick_ = wheel->now();
+        scheduleTimeout();
+    }
 }
 
 // 连接销毁
 void TCPConnection::connectDestoryed() {
+    if (!isOwnerThread()) {
+        forwardToOwner(std::bind(&TCPConnection::connectDestoryed, shared_from_this()));
+        return;
+    }
+    if (destroyed_) {
+        return;
+    }
+    destroyed_ = true;
     if (state_ == kConnected) {
         setState(kDisconnected);
-        channel_->disableAll();
+        channel_.disableAll();
 
-        connectionCallback_(shared_from_this());
+        callbacks_->connection(shared_from_this());
+    }
+    if (timeoutEntry_.linked()) {
+        getLoop()->timingWheel()->cancel(&timeoutEntry_);
     }
-    channel_->remove();
+    channel_.remove();
+    // 连接不再属于这个loop，没发出去的数据也不再计入负载
+    getLoop()->addPendingBytes(-static_cast<int64_t>(reportedPendingBytes_));
+    reportedPendingBytes_ = 0;
+    getLoop()->addConnections(-1);
+    producer_.reset();
+    // 没有机会再处理的数据，内存还给pool，之后连接对象可能比loop活得更久，不再使用pool
+    inputBuffer_.retrieveAll();
+    inputBuffer_.setPool(nullptr);
 }
 
 void TCPConnection::handleRead(Timestamp receiveTime) {
+    if (!isOwnerThread()) {
+        // 边缘触发模式下没读完的数据，新loop注册时会重新通知
+        return;
+    }
+    if (!channel_.isReading()) {
+        // 停止读取之前已经投递的读操作或者同一轮poll中的读事件，恢复读取时会重新通知
+        return;
+    }
+    if (channel_.isEdgeTriggered()) {
+        handleReadEdgeTriggered(receiveTime);
+        return;
+    }
+
     int savedErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    ssize_t n = inputBuffer_.readFd(channel_.fd(), &savedErrno);
+    addRelaxed(eventsHandled_, 1);
     if (n > 0) {
+        addRelaxed(bytesReceived_, n);
+        if (timeoutEnabled()) {
+            lastActiveTick_ = getLoop()->timingWheel()->now();
+        }
         // 已建立连接的用户，有可读事件发生了，调用用户传入的处理回调
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        callbacks_->message(shared_from_this(), &inputBuffer_, receiveTime);
+        // 数据取完时把内存还给loop的pool，突发的大块数据处理完之后不会一直占着内存
+        inputBuffer_.shrink();
     } else if (n == 0) {
         handleClose();
     } else {
@@ -146,48 +769,216 @@ void TCPConnection::handleRead(Timestamp receiveTime) {
     }
 }
 
-void TCPConnection::handleWrite() {
-    if (channel_->isWriting()) {
-        int saveErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
+// 边缘触发模式下一直读到EAGAIN，内核不会再通知已经存在的数据
+// 单次最多读kMaxReadBytesPerEvent字节，剩余的数据放到loop的回调队列中继续读，避免一个连接占满loop
+void TCPConnection::handleReadEdgeTriggered(Timestamp receiveTime) {
+    if (state_ != kConnected && state_ != kDisconnecting) {
+        return;
+    }
+
+    size_t total = 0;
+    bool drained = false;
+    bool closed = false;
+    int savedErrno = 0;
+    // 对端已经关闭或者出错时，没读满也不能认为读空了，要一直读到EOF或者错误，之后不会再有新的边缘
+    bool peerClosed = channel_.revents() & (EPOLLRDHUP | EPOLLHUP | EPOLLERR);
+    while (total < kMaxReadBytesPerEvent) {
+        // 空的缓冲区在readFd中才会借内存，先借好，按实际的可写空间判断是否读满
+        inputBuffer_.ensureStorage();
+        size_t writable = inputBuffer_.writableBytes();
+        size_t capacity = writable + (writable < Buffer::kExtraBufSize ? Buffer::kExtraBufSize : 0);
+        ssize_t n = inputBuffer_.readFd(channel_.fd(), &savedErrno);
         if (n > 0) {
-            outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0) {
-                channel_->disableWriting();
-                if (writeCompleteCallback_) {
-                    // 唤醒loop_对应thread线程，执行回调
-                    loop_->queueInLoop(
-                        std::bind(writeCompleteCallback_, shared_from_this()));
-                }
-                if (state_ == kDisconnecting) {
-                    shutdownInLoop();
-                }
+            total += n;
+            if (static_cast<size_t>(n) < capacity && !peerClosed) {
+                // 没有读满，说明接收缓冲区已经读空了，省掉一次返回EAGAIN的read
+                drained = true;
+                break;
             }
+        } else if (n == 0) {
+            closed = true;
+            break;
         } else {
-            LOG_ERROR("TCPConnection::handleWrite\n");
+            drained = savedErrno == EAGAIN || savedErrno == EWOULDBLOCK;
+            break;
         }
-    } else {
-        LOG_ERROR("TCOConnection fd=%d is down, no more writing\n", channel_->fd());
+    }
+
+    addRelaxed(eventsHandled_, 1);
+    if (total > 0) {
+        addRelaxed(bytesReceived_, total);
+        if (timeoutEnabled()) {
+            lastActiveTick_ = getLoop()->timingWheel()->now();
+        }
+        callbacks_->message(shared_from_this(), &inputBuffer_, receiveTime);
+        inputBuffer_.shrink();
+    }
+
+    if (state_ == kDisconnected) {
+        return;  // message回调中已经强制关闭了连接
+    }
+    if (closed) {
+        handleClose();
+    } else if (!drained && total >= kMaxReadBytesPerEvent) {
+        queueToLoop(std::bind(&TCPConnection::handleRead, shared_from_this(), receiveTime));
+    } else if (!drained) {
+        // ECONNRESET等错误，边缘触发模式下不会再有事件，直接关闭连接
+        errno = savedErrno;
+        LOG_ERROR("TCPConnection::handleRead\n");
+        handleError();
+        handleClose();
+    }
+}
+
+void TCPConnection::handleWrite() {
+    if (!isOwnerThread() || state_ == kDisconnected) {
+        // 迁移或者关闭之前投递的继续写操作
+        return;
+    }
+    if (!channel_.isWriting()) {
+        LOG_ERROR("TCOConnection fd=%d is down, no more writing\n", channel_.fd());
+        return;
+    }
+
+    addRelaxed(eventsHandled_, 1);
+    // 边缘触发模式下需要一直写到发送队列为空或者EAGAIN，否则不会再收到EPOLLOUT
+    // 流式发送时发送队列发完之后向producer要下一块数据接着写，一次事件最多拉取kMaxStreamBytesPerEvent字节
+    size_t pulled = 0;
+    bool starved = false;  // producer返回true但没有数据
+    for (;;) {
+        if (outputBuffer_.empty()) {
+            if (!producer_ || pulled >= kMaxStreamBytesPerEvent) {
+                break;
+            }
+            pulled += pullStream();
+            if (outputBuffer_.empty()) {
+                starved = producer_ != nullptr;
+                break;
+            }
+        }
+
+        int saveErrno = 0;
+        ssize_t n = outputBuffer_.writeFd(channel_.fd(), &saveErrno);
+        if (n <= 0) {
+            if (saveErrno != EAGAIN && saveErrno != EWOULDBLOCK) {
+                LOG_ERROR("TCPConnection::handleWrite errno=%d", saveErrno);
+            }
+            if (saveErrno == EIO) {
+                // 文件比声明的长度短，对端收到的数据已经不完整了
+                outputBuffer_.retrieveAll();
+                reportPendingBytes();
+                channel_.disableWriting();
+                forceCloseInLoop();
+            }
+            return;
+        }
+
+        addRelaxed(bytesSent_, n);
+        if (timeoutEnabled()) {
+            lastActiveTick_ = lastDrainTick_ = getLoop()->timingWheel()->now();
+        }
+        outputBuffer_.retrieve(n);
+        reportPendingBytes();
+        if (readPaused_ && outputBuffer_.readableBytes() <= flowLowMark_) {
+            readPaused_ = false;
+            updateReading();
+        }
+        if (!outputBuffer_.empty() && !channel_.isEdgeTriggered()) {
+            break;  // 水平触发模式下没写完，等下一次EPOLLOUT
+        }
+    }
+
+    if (!outputBuffer_.empty() || !channel_.isWriting()) {
+        return;
+    }
+    if (starved) {
+        // producer暂时没有数据，不再关注可写事件，否则会一直被唤醒拉到空数据，等resumeStream重新开始
+        channel_.disableWriting();
+        return;
+    }
+    if (producer_) {
+        if (channel_.isEdgeTriggered()) {
+            // 拉取的数据到了上限，socket仍然可写，不会再有新的EPOLLOUT，放到队列中继续
+            queueToLoop(std::bind(&TCPConnection::continueWrite, shared_from_this()));
+        }
+        return;
+    }
+    channel_.disableWriting();
+    if (callbacks_->writeComplete) {
+        // 唤醒loop_对应thread线程，执行回调
+        getLoop()->queueInLoop(
+            std::bind(callbacks_->writeComplete, shared_from_this()));
+    }
+    if (state_ == kDisconnecting) {
+        shutdownInLoop();
+    }
+}
+
+// 排队期间可能已经有EPOLLOUT把流发完或者暂停了，这时不再需要写
+void TCPConnection::continueWrite() {
+    if (isOwnerThread() && channel_.isWriting()) {
+        handleWrite();
     }
 }
 
 void TCPConnection::handleClose() {
-    LOG_INFO("fd = %d state = %d\n", channel_->fd(), int(state_));
+    LOG_INFO("fd = %d state = %d\n", channel_.fd(), int(state_));
     setState(kDisconnected);
-    channel_->disableAll();
+    channel_.disableAll();
+    // producer可能持有连接的智能指针
+    producer_.reset();
 
     TCPConnectionPtr connPtr(shared_from_this());
-    connectionCallback_(connPtr);  // 执行连接关闭的回调
-    closeCallback_(connPtr);       // 关闭连接的回调
+    callbacks_->connection(connPtr);  // 执行连接关闭的回调
+    callbacks_->close(connPtr);       // 关闭连接的回调
 }
 
 void TCPConnection::handleError() {
     int optval, err = 0;
     socklen_t optlen = sizeof(optval);
-    if (::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen)) {
+    if (::getsockopt(channel_.fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen)) {
         err = errno;
     } else {
         err = optval;
     }
-    LOG_ERROR("TCPConnection::hanlerError name:%s - SO_ERROR:%d\n", name_.c_str(), err);
+    LOG_ERROR("TCPConnection::hanlerError name:%s - SO_ERROR:%d\n", name().c_str(), err);
+}
+
+void TCPConnection::scheduleTimeout() {
+    TimingWheel *wheel = getLoop()->timingWheel();
+    uint64_t deadline = UINT64_MAX;
+    if (idleTicks_ > 0) {
+        deadline = lastActiveTick_ + idleTicks_;
+    }
+    if (writeStallTicks_ > 0 && outputBuffer_.readableBytes() > 0) {
+        deadline = std::min(deadline, lastDrainTick_ + writeStallTicks_);
+    }
+
+    if (deadline == UINT64_MAX) {
+        wheel->cancel(&timeoutEntry_);
+    } else {
+        uint64_t now = wheel->now();
+        wheel->schedule(&timeoutEntry_, deadline > now ? deadline - now : 1);
+    }
+}
+
+// 读写时只记录tick，时间轮到期后在这里检查是否真的超时，没有超时则重新调度
+void TCPConnection::handleTimeout() {
+    if (state_ != kConnected && state_ != kDisconnecting) {
+        return;
+    }
+
+    uint64_t now = getLoop()->timingWheel()->now();
+    if (idleTicks_ > 0 && now - lastActiveTick_ >= idleTicks_) {
+        LOG_INFO("TCPConnection::handleTimeout [%s] idle timeout, closing\n", name().c_str());
+        handleClose();
+        return;
+    }
+    if (writeStallTicks_ > 0 && outputBuffer_.readableBytes() > 0 && now - lastDrainTick_ >= writeStallTicks_) {
+        LOG_INFO("TCPConnection::handleTimeout [%s] output stalled with %lu bytes, closing\n",
+                 name().c_str(), outputBuffer_.readableBytes());
+        handleClose();
+        return;
+    }
+    scheduleTimeout();
 }
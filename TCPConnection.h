@@ -1,47 +1,124 @@
 #pragma once
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "Buffer.h"
 #include "Callbacks.h"
+#include "Channel.h"
+#include "EventLoop.h"
 #include "InetAddress.h"
+#include "OutputQueue.h"
+#include "Socket.h"
 #include "Timestamp.h"
+#include "TimingWheel.h"
 #include "nocopyable.h"
 
-class Channel;
-class EventLoop;
-class Socket;
-
 /*
  * TCPServer -> Acceptor 有一个新用户连接，通过accept函数拿到connfd
+ * TCPServer通过std::allocate_shared从ioLoop的slab分配连接，socket和channel直接内嵌在连接对象中
  */
 class TCPConnection : nocopyable, public std::enable_shared_from_this<TCPConnection> {
 public:
+    static const size_t kDefaultHighWaterMark = 64 * 1024 * 1024;
+
+    // namePrefix由同一个server的连接共享，连接名为"namePrefix#id"，第一次调用name()时才生成
+    // localAddr的ip是通配地址或者端口是0时表示还不知道，socket的选项(SO_KEEPALIVE)从监听socket继承
     TCPConnection(EventLoop *loop,
-                  const std::string &name,
+                  uint64_t id,
+                  const std::shared_ptr<const std::string> &namePrefix,
                   int sockfd,
                   const InetAddress &localAddr,
                   const InetAddress &peerAddr);
     ~TCPConnection();
 
-    EventLoop *getLoop() const { return loop_; }
-    const std::string &name() const { return name_; }
-    const InetAddress &localAddress() const { return localAddr_; }
+    // 连接迁移之后返回新的loop
+    EventLoop *getLoop() const { return loop_.load(std::memory_order_acquire); }
+    // server内唯一的连接ID，可以通过TCPServer::send(id, ...)在任意线程中给连接发送数据
+    uint64_t id() const { return id_; }
+    // 线程安全
+    const std::string &name() const;
+    // 线程安全，创建时不知道本地地址(监听通配地址)的连接第一次调用时才getsockname
+    const InetAddress &localAddress() const;
     const InetAddress &peerAddress() const { return peerAddr_; }
 
     bool connected() const { return state_ == kConnected; }
 
-    // 发送数据
+    // 发送数据，线程安全
+    // 在其他线程中调用时，数据的所有权会转移到loop线程，调用返回后调用者可以立即释放自己的数据
     void send(const std::string& buf);
+    // 转移buf的所有权，跨线程发送时不需要拷贝
+    void send(std::string&& buf);
+    void send(const void *data, size_t len);
+    // 和buf交换数据，调用之后buf为空
+    void send(Buffer *buf);
+    // 共享的数据，比如广播给多个连接的同一份消息，只增加引用计数
+    void send(const std::shared_ptr<const std::string> &data);
+    // 多个数据段(比如header和body)通过一次writev发送，不需要先拼接
+    void send(std::vector<std::string> &&pieces);
+    // 通过sendfile发送文件[offset, offset + length)区间的数据，排在已有的发送数据之后
+    // 内部会dup一份fd，调用返回之后调用者可以关闭自己的fd
+    void sendFile(int fd, off_t offset, size_t length);
+    // 流式发送，排在已有的发送数据之后，线程安全
+    // 发送队列发完并且socket可写时，在loop线程中调用producer填充下一块数据，发送中的数据始终只有一块
+    // producer返回false表示数据已经填完，全部发送之后调用writeComplete回调
+    // producer返回true但没有填充数据表示暂时没有数据，停止拉取，直到调用resumeStream
+    // 同一时间只能有一个流，producer持有的资源在流结束或者连接关闭时释放，流暂停期间shutdown等到流结束之后才关闭写端
+    void sendStream(const StreamProducer &producer);
+    // producer有了新的数据，继续流式发送，线程安全，没有暂停的流时什么也不做
+    void resumeStream();
+    // 设置TCP_NOTSENT_LOWAT，内核中没发出去的数据少于bytes字节时才可写，线程安全
+    // 流式发送时producer在内核快要发完时才被调用，内核中积压的数据也不超过bytes
+    void setTcpNotSentLowat(unsigned int bytes) { socket_.setTcpNotSentLowat(bytes); }
     // 关闭连接
     void shutdown();
-
-    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
-    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
-    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
-    void setHighWaterMarkCallback(const HighWaterMarkCallback &cb) { highWaterMarkCallback_ = cb; }
-    void setCloseCallback(const CloseCallback &cb) { closeCallback_ = cb; }
+    // 强制关闭连接，不等待发送缓冲区的数据发送完
+    void forceClose();
+
+    // 开始/停止读取数据，线程安全，停止期间数据留在内核的接收缓冲区中，由tcp的滑动窗口限制对端
+    void startRead();
+    void stopRead();
+    // 用户是否要求读取数据，不是线程安全的，流量控制暂停时仍然返回true
+    bool isReading() const { return reading_; }
+
+    // 把连接迁移到target，线程安全，迁移过程中收到和要发送的数据不会丢失，也不会乱序
+    // 迁移完成之后连接的回调都在target线程中执行，用户和loop线程绑定的数据需要自己处理
+    void migrate(EventLoop *target);
+    bool migrating() const { return migrating_.load(std::memory_order_acquire); }
+
+    // 负载统计，由所属loop更新，可以在其他线程中读取
+    uint64_t bytesReceived() const { return bytesReceived_.load(std::memory_order_relaxed); }
+    uint64_t bytesSent() const { return bytesSent_.load(std::memory_order_relaxed); }
+    // 处理过的读写事件次数
+    uint64_t eventsHandled() const { return eventsHandled_.load(std::memory_order_relaxed); }
+
+    // 空闲超时：超过seconds秒没有任何读写则关闭连接，0表示不启用
+    // 需要在connectEstablished之前设置
+    void setIdleTimeout(double seconds) { idleTimeout_ = seconds; }
+    // 写超时：发送缓冲区有数据，但超过seconds秒没有发出去任何字节则关闭连接(慢客户端)
+    void setWriteStallTimeout(double seconds) { writeStallTimeout_ = seconds; }
+    // 边缘触发模式：读到EAGAIN为止，EPOLLOUT一直注册，需要在connectEstablished之前设置
+    void setEdgeTriggered(bool on);
+
+    // 使用server共享的回调表，需要在connectEstablished之前设置
+    void setCallbacks(const ConnectionCallbacksPtr &callbacks) { callbacks_ = callbacks; }
+    // 单独修改某一个回调时拷贝一份自己的回调表，不影响其他连接
+    void setConnectionCallback(const ConnectionCallback &cb) { mutableCallbacks().connection = cb; }
+    void setMessageCallback(const MessageCallback &cb) { mutableCallbacks().message = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { mutableCallbacks().writeComplete = cb; }
+    void setHighWaterMarkCallback(const HighWaterMarkCallback &cb) { mutableCallbacks().highWaterMark = cb; }
+    // 发送队列增长到超过bytes字节时调用一次高水位回调
+    void setHighWaterMark(size_t bytes) { highWaterMark_ = bytes; }
+    // 自动流量控制：发送队列超过highMark字节时暂停读取，降到lowMark字节以下时恢复，highMark为0表示不启用
+    // lowMark不小于highMark时取highMark的一半
+    // 对端接收得比请求到达得慢时(比如代理)，不会一直读入新的请求而无限积压要发送的数据
+    void setFlowControl(size_t highMark, size_t lowMark) {
+        flowHighMark_ = highMark;
+        flowLowMark_ = lowMark < highMark ? lowMark : highMark / 2;
+    }
+    void setCloseCallback(const CloseCallback &cb) { mutableCallbacks().close = cb; }
 
     // 连接建立
     void connectEstablished();
@@ -53,34 +130,111 @@ private:
                  kConnecting,
                  kDisconnected,
                  kDisconnecting };
+    // 边缘触发模式下一次读事件最多读取的字节数，保证同一个loop上其他连接的公平性
+    static const size_t kMaxReadBytesPerEvent = 1024 * 1024;
+    // 流式发送时一次写事件最多拉取的字节数
+    static const size_t kMaxStreamBytesPerEvent = 1024 * 1024;
+
     void handleRead(Timestamp receiveTime);
+    void handleReadEdgeTriggered(Timestamp receiveTime);
     void handleWrite();
+    // 边缘触发模式下一次写事件拉取的流数据到了上限，放到队列中接着写
+    void continueWrite();
     void handleClose();
     void handleError();
 
     void sendInLoop(const void *message, size_t len);
+    void sendStringInLoop(std::string &message);
+    void sendBufferInLoop(Buffer &buf);
+    void sendSharedInLoop(const std::shared_ptr<const std::string> &data);
+    void sendPiecesInLoop(std::vector<std::string> &pieces);
+    void sendFileInLoop(const OutputQueue::FileHandle &file, off_t offset, size_t length);
+    void sendStreamInLoop(const StreamProducer &producer);
+    void resumeStreamInLoop();
+    // 向producer要下一块数据放入发送队列，返回拿到的字节数
+    size_t pullStream();
+    void flushIfIdle(bool idle);
+    ssize_t writeDirectly(const void *data, size_t len);
+    void outputQueued(size_t oldLen);
+    // 把发送队列长度的变化同步到loop的负载计数
+    void reportPendingBytes();
     void shutdownInLoop();
+    void forceCloseInLoop();
+    void startReadInLoop();
+    void stopReadInLoop();
+    // 根据用户的设置和流量控制的状态注册或者取消读事件
+    void updateReading();
+
+    // 根据最近的读写时间，在时间轮上调度下一次超时检查
+    void scheduleTimeout();
+    // 时间轮超时的回调
+    void handleTimeout();
+    bool timeoutEnabled() const { return idleTicks_ > 0 || writeStallTicks_ > 0; }
 
     void setState(State state) { state_ = state; }
 
-    EventLoop *loop_;
-    const std::string name_;
+    ConnectionCallbacks &mutableCallbacks();
+    // 根据超时设置在所属loop的时间轮上开始计时
+    void startTimeout();
+
+    // 当前线程是否是连接所属的loop线程，只有所属的loop线程可以访问连接的状态
+    bool isOwnerThread() const;
+    // 把操作交给所属的loop线程执行，迁移开始之后会投递到新的loop
+    void queueToLoop(EventLoop::Functor cb);
+    // 在不是所属loop的线程中调用了只能在loop线程中执行的操作(迁移前投递到原loop的操作)，转交出去
+    void forwardToOwner(EventLoop::Functor cb);
+    void migrateInLoop(EventLoop *target);
+    // 在原loop中注销channel，交给新的loop
+    void handoffInLoop();
+    // 在新loop中重新注册channel，执行迁移期间推迟的操作
+    void migrateEstablished(bool reading, bool writing);
+
+    std::atomic<EventLoop *> loop_;  // 所属的loop，只在迁移时改变
+    const uint64_t id_;
+    const std::shared_ptr<const std::string> namePrefix_;
+    mutable std::once_flag nameOnce_;
+    mutable std::string name_;
     std::atomic_int state_;
-    bool reading_;
+    bool reading_;     // 用户通过startRead/stopRead设置
+    bool readPaused_;  // 流量控制暂停了读取
 
-    std::unique_ptr<Socket> socket_;
-    std::unique_ptr<Channel> channel_;
+    Socket socket_;
+    Channel channel_;  // 迁移时换到新的loop，对象本身不变
 
-    const InetAddress localAddr_;
+    mutable std::once_flag localAddrOnce_;
+    mutable InetAddress localAddr_;
     const InetAddress peerAddr_;
 
-    ConnectionCallback connectionCallback_;
-    MessageCallback messageCallback_;
-    WriteCompleteCallback writeCompleteCallback_;
-    HighWaterMarkCallback highWaterMarkCallback_;
-    CloseCallback closeCallback_;
+    ConnectionCallbacksPtr callbacks_;
     size_t highWaterMark_;
-
-    Buffer inputBuffer_;   // 接受数据缓冲区
-    Buffer outputBuffer_;  // 发送数据缓冲区
+    size_t flowHighMark_;
+    size_t flowLowMark_;
+
+    Buffer inputBuffer_;   // 接受数据缓冲区，从所属loop的BufferPool借内存，数据取完就归还
+    OutputQueue outputBuffer_;  // 发送队列，由多个数据段组成
+    std::unique_ptr<StreamProducer> producer_;  // 正在进行的流式发送，大部分连接没有
+    size_t reportedPendingBytes_;  // 已经计入loop负载的发送队列字节数
+
+    // 超时管理，时间以所属loop时间轮的tick为单位，刷新时只需要记录当前tick
+    double idleTimeout_;
+    double writeStallTimeout_;
+    uint64_t idleTicks_;
+    uint64_t writeStallTicks_;
+    uint64_t lastActiveTick_;  // 最近一次读写数据的tick
+    uint64_t lastDrainTick_;   // 发送缓冲区最近一次有进展的tick
+    TimingWheel::Entry timeoutEntry_;
+
+    std::atomic<uint64_t> bytesReceived_;
+    std::atomic<uint64_t> bytesSent_;
+    std::atomic<uint64_t> eventsHandled_;
+
+    // 迁移状态
+    // 其他线程投递操作时先读取queueLoop_再放入它的队列，两步在queueMutex_中完成
+    // 迁移开始时在锁中切换queueLoop_，之后原loop的队列中不会再有这个连接的新操作
+    std::mutex queueMutex_;
+    EventLoop *queueLoop_;
+    std::atomic_bool migrating_;
+    std::atomic<EventLoop *> migrateTarget_;
+    bool destroyed_;  // 已经调用过connectDestoryed
+    std::vector<EventLoop::Functor> deferred_;  // 新loop中在迁移完成之前收到的操作
 };
\ No newline at end of file
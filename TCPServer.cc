@@ -2,36 +2,106 @@
 
 #include <string.h>
 
+#include <algorithm>
+#include <future>
+
+#include "Slab.h"
+
+
+// 连接的数据包由哪个cpu处理，获取失败时返回-1
+static int incomingCpu(int sockfd) {
+    int cpu = -1;
+    socklen_t len = static_cast<socklen_t>(sizeof(cpu));
+    if (::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0) {
+        return -1;
+    }
+    return cpu;
+}
 
 EventLoop *CheckLoopNotNull(EventLoop *loop) {
     if (loop == nullptr) {
-        LOG_FATAL("%s:%s:%d mainLoop is null!\n", __FILE__, __FUNCTION__, _LINES__);
+        LOG_FATAL("%s:%s:%d mainLoop is null!\n", __FILE__, __FUNCTION__, __LINE__);
     }
     return loop;
 }
 
 TCPServer::TCPServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg, Option option)
     : loop_(CheckLoopNotNull(loop))
+    , listenAddr_(listenAddr)
     , ipPort_(listenAddr.toIpPort())
     , name_(nameArg)
-    , acceptor_(new Acceptor(loop, listenAddr, option))
+    , connNamePrefix_(std::make_shared<const std::string>(nameArg + "-" + ipPort_))
+    , option_(option)
     , threadPool_(new EventLoopThreadPool(loop_, name_))
-    , connectionCallback_()
-    , messageCallback_()
-    , nextConnId_(1)
-    , started_(0) {
-    acceptor_->setNewConnectionCallback(std::bind(&TCPServer::newConnection, this,
-                                                  std::placeholders::_1, std::placeholders::_2));
+    , started_(0)
+    , idleTimeout_(0.0)
+    , writeStallTimeout_(0.0)
+    , highWaterMark_(TCPConnection::kDefaultHighWaterMark)
+    , flowHighMark_(0)
+    , flowLowMark_(0)
+    , edgeTriggered_(false)
+    , cpuSteering_(false)
+    , rebalanceInterval_(0.0)
+    , rebalanceThreshold_(1.5) {
+    // kReusePort模式下由subloop各自创建监听socket，没有subloop时才在start中创建baseLoop的acceptor
+    if (option_ != kReusePort) {
+        createAcceptor(false);
+    }
+    std::shared_ptr<ConnectionCallbacks> callbacks = std::make_shared<ConnectionCallbacks>();
+    // 设置关闭连接的回调
+    callbacks->close = std::bind(&TCPServer::removeConnection, this, std::placeholders::_1);
+    callbacks_ = callbacks;
+}
+
+void TCPServer::createAcceptor(bool reuseport) {
+    acceptor_.reset(new Acceptor(loop_, listenAddr_, reuseport));
+    acceptor_->setNewConnectionBatchCallback(std::bind(&TCPServer::newConnections, this,
+                                                       static_cast<EventLoop *>(nullptr), std::placeholders::_1));
+}
+
+ConnectionCallbacks &TCPServer::mutableCallbacks() {
+    std::shared_ptr<ConnectionCallbacks> callbacks = std::make_shared<ConnectionCallbacks>(*callbacks_);
+    callbacks_ = callbacks;
+    return *callbacks;
 }
 
 TCPServer::~TCPServer() {
-    for (auto &item : connections_) {
-        // 局部对象的智能指针，作用域结束后会自动释放new出来的TCPConnection对象资源
-        TCPConnectionPtr conn(item.second);
-        item.second.reset();
-        // 销毁连接
-        conn->getLoop()->runInLoop(
-            std::bind(&TCPConnection::connectDestoryed, conn));
+    // 在baseloop中取消rebalance定时器并等待完成，之后定时器不会再访问this
+    if (rebalanceInterval_ > 0.0) {
+        std::promise<void> done;
+        loop_->runInLoop([this, &done] {
+            loop_->cancel(rebalanceTimer_);
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+
+    // subloop的acceptor在各自的loop中销毁，之后不会再有新连接
+    std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+    for (size_t i = 0; i < loopAcceptors_.size(); ++i) {
+        std::unique_ptr<Acceptor> &acceptor = loopAcceptors_[i];
+        std::promise<void> done;
+        loops[i]->runInLoop([&acceptor, &done] {
+            acceptor.reset();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+
+    for (std::unique_ptr<ConnectionShard> &shard : shards_) {
+        ConnectionMap connections;
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            connections.swap(shard->connections);
+        }
+        for (auto &item : connections) {
+            // 局部对象的智能指针，作用域结束后会自动释放TCPConnection对象资源
+            TCPConnectionPtr conn(item.second);
+            item.second.reset();
+            // 销毁连接
+            conn->getLoop()->runInLoop(
+                std::bind(&TCPConnection::connectDestoryed, conn));
+        }
     }
 }
 
@@ -45,50 +115,273 @@ void TCPServer::start() {
     // 赋值一个TCPServer对象被start多次
     if (started_++ == 0) {
         threadPool_->start(threadInitCallback_);
-        loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        shardLoops_ = threadPool_->getAllLoops();
+        for (size_t i = 0; i < shardLoops_.size(); ++i) {
+            shards_.emplace_back(new ConnectionShard);
+        }
+
+        std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+        if (option_ == kNoReusePort || (loops.size() == 1 && loops[0] == loop_)) {
+            // 只有baseLoop接受连接，再轮询分发给subloop
+            if (!acceptor_) {
+                createAcceptor(true);
+            }
+            loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        } else {
+            // 每个subloop在自己的线程中accept，新连接不需要跨线程传递
+            loopAcceptors_.resize(loops.size());
+            bool attachProgram = option_ == kReusePort && cpuSteering_;
+            for (size_t i = 0; i < loops.size(); ++i) {
+                if (!attachProgram) {
+                    loops[i]->runInLoop(std::bind(&TCPServer::startLoopAcceptor, this, loops[i], i));
+                    continue;
+                }
+                // BPF程序返回的是监听socket在组内的下标，即listen的顺序，需要依次启动
+                std::promise<void> done;
+                loops[i]->runInLoop([this, &loops, i, &done] {
+                    startLoopAcceptor(loops[i], i);
+                    done.set_value();
+                });
+                done.get_future().wait();
+            }
+            if (attachProgram && !threadPool_->cpuLoops().empty()) {
+                loopAcceptors_[0]->attachCpuSteeringProgram(threadPool_->cpuLoops());
+            }
+        }
+        if (rebalanceInterval_ > 0.0) {
+            rebalanceTimer_ = loop_->runEvery(rebalanceInterval_, std::bind(&TCPServer::rebalance, this));
+        }
     }
 }
 
-void TCPServer::newConnection(int sockfd, const InetAddress &peerAddr) {
-    EventLoop *ioLoop = threadPool_->getNextLoop();
-    char buf[64];
-    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
-    std::string connName = name_ + buf;
+void TCPServer::startLoopAcceptor(EventLoop *ioLoop, size_t index) {
+    Acceptor *acceptor = nullptr;
+    if (option_ == kReusePort) {
+        acceptor = new Acceptor(ioLoop, listenAddr_, true);
+    } else {
+        acceptor = new Acceptor(ioLoop, acceptor_->listenFd());
+    }
+    acceptor->setNewConnectionBatchCallback(std::bind(&TCPServer::newConnections, this, ioLoop,
+                                                      std::placeholders::_1));
+    loopAcceptors_[index].reset(acceptor);
+    acceptor->listen();
+}
 
-    LOG_INFO("TCPServer::newConnection [%s] - new connection [%s] from %s\n",
-             name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
+void TCPServer::newConnections(EventLoop *ioLoop, const Acceptor::AcceptedList &accepted) {
+    // 按loop分组，subloop的个数不多，直接线性查找
+    std::vector<std::pair<EventLoop *, Acceptor::AcceptedList>> groups;
+    for (const Acceptor::AcceptedConnection &item : accepted) {
+        EventLoop *loop = cpuSteering_ ? threadPool_->loopForCpu(incomingCpu(item.sockfd)) : nullptr;
+        if (loop == nullptr) {
+            loop = ioLoop != nullptr ? ioLoop : threadPool_->getNextLoop();
+        }
+        size_t i = 0;
+        while (i < groups.size() && groups[i].first != loop) {
+            ++i;
+        }
+        if (i == groups.size()) {
+            groups.emplace_back(loop, Acceptor::AcceptedList());
+        }
+        groups[i].second.push_back(item);
+    }
 
-    // 通过sockfd获取绑定的本地IP地址和端口信息
-    sockaddr_in local;
-    ::bzero(&local, sizeof(local));
-    socklen_t addrlen = static_cast<socklen_t>(sizeof(local));
-    if (::getsockname(sockfd, (struct sockaddr *)&local, &addrlen) < 0) {
-        LOG_ERROR("sockets::getLocalAddr");
+    // 每个loop只唤醒一次
+    for (auto &group : groups) {
+        EventLoop *loop = group.first;
+        if (threadPool_->numaLocal()) {
+            // 连接对象在ioLoop线程中创建，从ioLoop所在的NUMA节点分配内存
+            loop->runInLoop(std::bind(&TCPServer::createConnectionsInLoop, this, loop, std::move(group.second)));
+        } else {
+            // 在ioLoop中依次调用TCPConnection::connectEstablished
+            loop->runInLoop(std::bind(&TCPServer::establishConnections, createConnections(loop, group.second)));
+        }
     }
+}
 
-    InetAddress localAddr(local);
-    TCPConnectionPtr conn(new TCPConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
-    connections_[connName] = conn;
-    conn->setConnectionCallback(connectionCallback_);
-    conn->setMessageCallback(messageCallback_);
-    conn->setWriteCompleteCallback(writeCompleteCallback_);
-    // 设置关闭连接的回调
-    conn->setCloseCallback(
-        std::bind(&TCPServer::removeConnection, this, std::placeholders::_1));
-    // 直接调用TCPConnection::connectEstablished
-    ioLoop->runInLoop(std::bind(&TCPConnection::connectEstablished, conn));
+std::vector<TCPConnectionPtr> TCPServer::createConnections(EventLoop *ioLoop, const Acceptor::AcceptedList &accepted) {
+    size_t index = std::find(shardLoops_.begin(), shardLoops_.end(), ioLoop) - shardLoops_.begin();
+    ConnectionShard &shard = *shards_[index];
+    uint64_t seq = shard.nextSeq.fetch_add(accepted.size(), std::memory_order_relaxed);
+
+    std::vector<TCPConnectionPtr> conns;
+    conns.reserve(accepted.size());
+    for (const Acceptor::AcceptedConnection &item : accepted) {
+        uint64_t id = seq++ * shards_.size() + index;
+        conns.push_back(createConnection(ioLoop, id, item.sockfd, item.peerAddr));
+    }
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (const TCPConnectionPtr &conn : conns) {
+        shard.connections[conn->id()] = conn;
+    }
+    return conns;
 }
 
-void TCPServer::removeConnection(const TCPConnectionPtr &conn) {
-    loop_->runInLoop(std::bind(&TCPServer::removeConnectionInLoop, this, conn));
+void TCPServer::createConnectionsInLoop(EventLoop *ioLoop, const Acceptor::AcceptedList &accepted) {
+    establishConnections(createConnections(ioLoop, accepted));
+}
+
+TCPConnectionPtr TCPServer::createConnection(EventLoop *ioLoop, uint64_t id, int sockfd, const InetAddress &peerAddr) {
+    LOG_INFO("TCPServer::newConnection [%s] - new connection [%s#%lu] from %s\n",
+             name_.c_str(), connNamePrefix_->c_str(), id, peerAddr.toIpPort().c_str());
+
+    // 监听的不是通配地址时本地地址就是监听地址，否则由连接在第一次用到时再getsockname
+    // 连接对象和shared_ptr的控制块一起从ioLoop的slab中分配
+    TCPConnectionPtr conn = std::allocate_shared<TCPConnection>(SlabAllocator<TCPConnection>(ioLoop->connectionSlab()),
+                                                                ioLoop, id, connNamePrefix_, sockfd, listenAddr_, peerAddr);
+    conn->setCallbacks(callbacks_);
+    conn->setIdleTimeout(idleTimeout_);
+    conn->setWriteStallTimeout(writeStallTimeout_);
+    conn->setHighWaterMark(highWaterMark_);
+    conn->setFlowControl(flowHighMark_, flowLowMark_);
+    conn->setEdgeTriggered(edgeTriggered_);
+    return conn;
 }
 
-void TCPServer::removeConnectionInLoop(const TCPConnectionPtr &conn) {
-    LOG_INFO("TCPServer::removeConnectionInLoop [%s] - connection %s\n", name_.c_str(), conn->name().c_str());
-    size_t n = connections_.erase(conn->name());
+void TCPServer::establishConnections(const std::vector<TCPConnectionPtr> &conns) {
+    for (const TCPConnectionPtr &conn : conns) {
+        conn->connectEstablished();
+    }
+}
 
+// 在连接所属的ioLoop中调用，只需要锁住连接所在的分片，不需要切换到baseLoop
+void TCPServer::removeConnection(const TCPConnectionPtr &conn) {
+    LOG_INFO("TCPServer::removeConnection [%s] - connection %s\n", name_.c_str(), conn->name().c_str());
+    ConnectionShard *shard = shardFor(conn->id());
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->connections.erase(conn->id());
+    }
+
+    // 当前还在channel的事件回调中，放到这一轮事件处理完之后，还是在同一个loop中执行
     EventLoop *ioLoop = conn->getLoop();
     ioLoop->queueInLoop(
         std::bind(&TCPConnection::connectDestoryed, conn));
-}
\ No newline at end of file
+}
+
+TCPServer::ConnectionShard *TCPServer::shardFor(uint64_t connId) {
+    if (shards_.empty()) {
+        return nullptr;
+    }
+    return shards_[connId % shards_.size()].get();
+}
+
+TCPConnectionPtr TCPServer::findConnection(uint64_t connId) {
+    ConnectionShard *shard = shardFor(connId);
+    if (shard == nullptr) {
+        return TCPConnectionPtr();
+    }
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    auto it = shard->connections.find(connId);
+    return it != shard->connections.end() ? it->second : TCPConnectionPtr();
+}
+
+bool TCPServer::send(uint64_t connId, const std::string &message) {
+    TCPConnectionPtr conn = findConnection(connId);
+    if (!conn || !conn->connected()) {
+        return false;
+    }
+    conn->send(message);
+    return true;
+}
+
+bool TCPServer::send(uint64_t connId, std::string &&message) {
+    TCPConnectionPtr conn = findConnection(connId);
+    if (!conn || !conn->connected()) {
+        return false;
+    }
+    conn->send(std::move(message));
+    return true;
+}
+
+size_t TCPServer::numConnections() {
+    size_t total = 0;
+    for (std::unique_ptr<ConnectionShard> &shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        total += shard->connections.size();
+    }
+    return total;
+}
+namespace {
+
+// 一次事件处理(系统调用和回调)的开销，大致相当于拷贝这么多字节的数据
+const uint64_t kBytesPerEvent = 4096;
+// 每次rebalance最多迁移的连接数，避免一次迁移太多连接造成抖动
+const int kMaxMigrationsPerRound = 4;
+
+}  // namespace
+
+void TCPServer::rebalance() {
+    std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+    if (loops.size() < 2) {
+        return;
+    }
+
+    struct Sample {
+        TCPConnectionPtr conn;
+        size_t loop;
+        uint64_t load;
+    };
+    std::vector<Sample> samples;
+    for (std::unique_ptr<ConnectionShard> &shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        for (const auto &item : shard->connections) {
+            samples.push_back(Sample{item.second, 0, 0});
+        }
+    }
+
+    // 这段时间内每个连接和每个loop的负载
+    std::unordered_map<uint64_t, uint64_t> loads;
+    std::vector<uint64_t> loopLoads(loops.size(), 0);
+    uint64_t total = 0;
+    for (Sample &sample : samples) {
+        TCPConnection *conn = sample.conn.get();
+        uint64_t cumulative = conn->bytesReceived() + conn->bytesSent() + conn->eventsHandled() * kBytesPerEvent;
+        auto it = lastLoads_.find(conn->id());
+        uint64_t last = it != lastLoads_.end() && it->second <= cumulative ? it->second : 0;
+        loads[conn->id()] = cumulative;
+        sample.load = cumulative - last;
+
+        EventLoop *loop = conn->getLoop();
+        sample.loop = std::find(loops.begin(), loops.end(), loop) - loops.begin();
+        if (sample.loop == loops.size() || conn->migrating()) {
+            sample.load = 0;  // 不参与这一轮
+            continue;
+        }
+        loopLoads[sample.loop] += sample.load;
+        total += sample.load;
+    }
+    lastLoads_.swap(loads);
+    if (total == 0) {
+        return;
+    }
+
+    double mean = static_cast<double>(total) / loops.size();
+    for (int round = 0; round < kMaxMigrationsPerRound; ++round) {
+        size_t busiest = std::max_element(loopLoads.begin(), loopLoads.end()) - loopLoads.begin();
+        size_t idlest = std::min_element(loopLoads.begin(), loopLoads.end()) - loopLoads.begin();
+        if (loopLoads[busiest] <= mean * rebalanceThreshold_) {
+            break;
+        }
+
+        // 迁移之后最闲的loop不能比原来最忙的loop更忙，选满足条件的负载最大的连接
+        uint64_t gap = loopLoads[busiest] - loopLoads[idlest];
+        Sample *chosen = nullptr;
+        for (Sample &sample : samples) {
+            if (sample.loop == busiest && sample.load > 0 && sample.load < gap &&
+                (chosen == nullptr || sample.load > chosen->load)) {
+                chosen = &sample;
+            }
+        }
+        if (chosen == nullptr) {
+            break;
+        }
+
+        LOG_INFO("TCPServer::rebalance [%s] - migrate %s from loop %lu to loop %lu\n",
+                 name_.c_str(), chosen->conn->name().c_str(), busiest, idlest);
+        chosen->conn->migrate(loops[idlest]);
+        loopLoads[busiest] -= chosen->load;
+        loopLoads[idlest] += chosen->load;
+        chosen->loop = idlest;
+    }
+}
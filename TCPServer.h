@@ -3,8 +3,10 @@
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "Acceptor.h"
 #include "Buffer.h"
@@ -23,7 +25,10 @@ public:
 
     enum Option {
         kNoReusePort,
-        kReusePort
+        // 每个subloop有自己的SO_REUSEPORT监听socket，由内核分配连接，在各自的loop中accept
+        kReusePort,
+        // 所有subloop共享同一个监听socket，通过EPOLLEXCLUSIVE每次只唤醒一个loop，在各自的loop中accept
+        kSharedListener
     };
 
     TCPServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg, Option option = kNoReusePort);
@@ -31,35 +36,126 @@ public:
 
     // 设置对应的回调
     void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
-    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
-    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
-    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+    // 连接的回调保存在所有连接共享的回调表中，修改时拷贝一份新表，只影响之后创建的连接
+    void setConnectionCallback(const ConnectionCallback &cb) { mutableCallbacks().connection = cb; }
+    void setMessageCallback(const MessageCallback &cb) { mutableCallbacks().message = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { mutableCallbacks().writeComplete = cb; }
+    // 连接的发送队列增长到超过highWaterMark字节时回调，可以在回调中stopRead，发送完成之后再startRead
+    void setHighWaterMarkCallback(const HighWaterMarkCallback &cb,
+                                  size_t highWaterMark = TCPConnection::kDefaultHighWaterMark) {
+        mutableCallbacks().highWaterMark = cb;
+        highWaterMark_ = highWaterMark;
+    }
+    // 所有连接启用自动流量控制，见TCPConnection::setFlowControl，只影响之后创建的连接
+    void setFlowControl(size_t highMark, size_t lowMark) {
+        flowHighMark_ = highMark;
+        flowLowMark_ = lowMark;
+    }
 
     // 设置底层subloop的个数
     void setThreadNum(int numThreads);
+    // subloop使用的IO复用实现(epoll/io_uring)，需要在start之前设置，baseLoop由用户创建，不受影响
+    void setPollerBackend(EventLoop::Backend backend) { threadPool_->setBackend(backend); }
+    // 第i个subloop绑定到cpus[i % cpus.size()]上运行，需要在start之前设置
+    void setCpuAffinity(const std::vector<int> &cpus) { threadPool_->setCpuAffinity(cpus); }
+    // subloop优先从所在NUMA节点分配内存，新连接也在subloop中创建，需要在start之前设置
+    void setNumaLocal(bool on) { threadPool_->setNumaLocal(on); }
+    // 按照连接数据包到达的cpu(SO_INCOMING_CPU)把连接交给绑定在这个cpu(或同一NUMA节点)上的subloop
+    // 需要同时设置setCpuAffinity，kReusePort模式下还会给监听组挂载BPF程序，由内核直接选择对应loop的监听socket
+    // 需要在start之前设置
+    void setIncomingCpuSteering(bool on) { cpuSteering_ = on; }
+
+    // 新连接分配给subloop的策略，默认轮询
+    void setLoopSelectPolicy(LoopSelector::Policy policy) { threadPool_->setLoopSelectPolicy(policy); }
+    // 自定义的分配策略，接管selector的所有权
+    void setLoopSelector(LoopSelector *selector) { threadPool_->setLoopSelector(selector); }
+
+    // 连接超过seconds秒没有读写则关闭，由各个loop的时间轮管理，0表示不启用
+    void setIdleTimeout(double seconds) { idleTimeout_ = seconds; }
+    // 连接的发送缓冲区超过seconds秒没有进展则关闭，用于淘汰慢客户端，0表示不启用
+    void setWriteStallTimeout(double seconds) { writeStallTimeout_ = seconds; }
+    // 连接使用边缘触发模式，适合大流量的连接，减少epoll_wait的唤醒和epoll_ctl的调用
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+    // 每隔seconds秒检查一次各个subloop的负载，把最忙的loop上的连接迁移到最闲的loop，0表示不启用
+    // 负载按照这段时间内每个连接读写的字节数和事件数估算，需要在start之前设置
+    void setRebalanceInterval(double seconds) { rebalanceInterval_ = seconds; }
+    // 最忙的loop超过平均负载的倍数时才迁移，默认1.5
+    void setRebalanceThreshold(double ratio) { rebalanceThreshold_ = ratio; }
 
     // 开启服务器监听
     void start();
 
+    // 通过连接ID(TCPConnection::id)给连接发送数据，线程安全，适合只保存了ID的业务线程
+    // 连接已经关闭或者不存在时返回false
+    bool send(uint64_t connId, const std::string &message);
+    bool send(uint64_t connId, std::string &&message);
+    // 通过连接ID查找连接，线程安全，找不到时返回空指针
+    TCPConnectionPtr findConnection(uint64_t connId);
+    // 当前的连接数，线程安全
+    size_t numConnections();
+
 private:
-    void newConnection(int sockfd, const InetAddress &peerAddr);
+    // acceptor一次接受的一批连接，ioLoop为nullptr时轮询分发给subloop，否则都交给ioLoop
+    // 同一个loop的连接只需要一次runInLoop，可能在baseLoop或者ioLoop中调用
+    void newConnections(EventLoop *ioLoop, const Acceptor::AcceptedList &accepted);
+    // 创建一组属于ioLoop的连接并注册到ioLoop的分片中
+    std::vector<TCPConnectionPtr> createConnections(EventLoop *ioLoop, const Acceptor::AcceptedList &accepted);
+    void createConnectionsInLoop(EventLoop *ioLoop, const Acceptor::AcceptedList &accepted);
+    TCPConnectionPtr createConnection(EventLoop *ioLoop, uint64_t id, int sockfd, const InetAddress &peerAddr);
+    static void establishConnections(const std::vector<TCPConnectionPtr> &conns);
     void removeConnection(const TCPConnectionPtr &conn);
-    void removeConnectionInLoop(const TCPConnectionPtr &conn);
+    // 在baseLoop中定期执行，迁移连接平衡各个subloop的负载
+    void rebalance();
+    // 在第index个subloop中创建并启动它自己的acceptor
+    void startLoopAcceptor(EventLoop *ioLoop, size_t index);
+    // 创建运行在baseLoop中的acceptor，绑定监听地址
+    void createAcceptor(bool reuseport);
+    ConnectionCallbacks &mutableCallbacks();
 
-    using ConnectionMap = std::unordered_map<std::string, TCPConnectionPtr>;
+    using ConnectionMap = std::unordered_map<uint64_t, TCPConnectionPtr>;
+    // 连接表按照创建连接时所属的subloop分片，每个分片有自己的锁，不同loop的连接注册和删除互不影响
+    // 连接ID = 分片内的序号 * 分片数 + 分片下标，通过ID直接找到分片，迁移之后仍然留在原来的分片中
+    struct ConnectionShard {
+        std::mutex mutex;
+        ConnectionMap connections;
+        std::atomic<uint64_t> nextSeq{1};
+    };
+    ConnectionShard *shardFor(uint64_t connId);
     EventLoop *loop_;  // baseLoop 用户定义的loop
+    const InetAddress listenAddr_;
     const std::string ipPort_;
     const std::string name_;
-    std::unique_ptr<Acceptor> acceptor_;  // 运行在mainLoop，监听连接事件
+    // 连接名的前缀"name-ip:port"，所有连接共享
+    const std::shared_ptr<const std::string> connNamePrefix_;
+    const Option option_;
+    std::unique_ptr<Acceptor> acceptor_;  // 运行在mainLoop，监听连接事件，kReusePort模式下有subloop时为空
+    // kReusePort/kSharedListener模式下每个subloop的acceptor，只在各自的loop中创建和销毁
+    std::vector<std::unique_ptr<Acceptor>> loopAcceptors_;
+    // 每个subloop一个分片，在start中创建，之后不再变化
+    // 声明在threadPool_之前，loop线程全部退出之后才析构，关闭中的连接仍然可以从分片中移除
+    std::vector<EventLoop *> shardLoops_;
+    std::vector<std::unique_ptr<ConnectionShard>> shards_;
     std::shared_ptr<EventLoopThreadPool> threadPool_;
 
-    ConnectionCallback connectionCallback_;        // 有新连接时的回调
-    MessageCallback messageCallback_;              // 有读写消息时的回调
-    WriteCompleteCallback writeCompleteCallback_;  // 消息发送完成后的回调
-    ThreadInitCallback threadInitCallback_;        // loop线程初始化的回调
+    // 有新连接、有读写消息、消息发送完成、连接关闭的回调，所有连接共享
+    ConnectionCallbacksPtr callbacks_;
+    ThreadInitCallback threadInitCallback_;  // loop线程初始化的回调
 
     std::atomic_int started_;
 
-    int nextConnId_;
-    ConnectionMap connections_;  // 保存所有的连接
+    double idleTimeout_;
+    double writeStallTimeout_;
+    size_t highWaterMark_;
+    size_t flowHighMark_;
+    size_t flowLowMark_;
+    bool edgeTriggered_;
+    bool cpuSteering_;
+
+    double rebalanceInterval_;
+    double rebalanceThreshold_;
+    TimerId rebalanceTimer_;
+    // 上一次rebalance时每个连接的累计负载，按连接ID索引，只在baseLoop中访问
+    // 连接对象的内存会被slab立即复用，不能用指针作为key
+    std::unordered_map<uint64_t, uint64_t> lastLoads_;
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "Thread.h"
 #include "CurrentThread.h"
+#include <pthread.h>
 #include <semaphore.h>
 
 std::atomic_int Thread::numCreated_(0);
@@ -28,6 +29,8 @@ void Thread::start() {
     thread_ = std::shared_ptr<std::thread>(new std::thread([&]{
         // 获取线程的tid
         tid_ = CurrentThread::tid();
+        // 设置系统中的线程名，在top/perf中可以看到，最长15个字符
+        ::pthread_setname_np(::pthread_self(), name_.substr(0, 15).c_str());
         sem_post(&sem);
         // 开启新线程，执行线程函数
         func_(); 
@@ -43,7 +46,7 @@ void Thread::join() {
 }
 
 void Thread::setDefaultName() {
-    int num = numCreated_;
+    int num = ++numCreated_;
     if (name_.empty()) {
         char buf[32];
         snprintf(buf, sizeof(buf), "Thread%d", num);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+
+#include "Callbacks.h"
+#include "Timestamp.h"
+#include "nocopyable.h"
+
+// 定时器，记录超时时间、回调以及重复的间隔
+class Timer : nocopyable {
+public:
+    Timer(TimerCallback cb, Timestamp when, double interval)
+        : callback_(std::move(cb))
+        , expiration_(when)
+        , interval_(interval)
+        , repeat_(interval > 0.0)
+        , sequence_(++numCreated_) {}
+
+    void run() const { callback_(); }
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    // 重复的定时器，重新计算下一次超时时间
+    void restart(Timestamp now);
+
+    static int64_t numCreated() { return numCreated_; }
+
+private:
+    const TimerCallback callback_;
+    Timestamp expiration_;
+    const double interval_;  // 重复的间隔，单位秒
+    const bool repeat_;
+    const int64_t sequence_;  // 全局唯一的序号，和Timer*一起标识定时器
+
+    static std::atomic<int64_t> numCreated_;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <set>
+#include <vector>
+
+#include "Callbacks.h"
+#include "Channel.h"
+#include "TimerId.h"
+#include "Timestamp.h"
+#include "nocopyable.h"
+
+class EventLoop;
+class Timer;
+
+/**
+ * 定时器队列，每个EventLoop拥有一个
+ * 所有定时器按超时时间有序存放在set中，插入和删除都是O(logn)
+ * 底层只用一个timerfd，超时时间设置为最早的定时器，timerfd可读时由Channel回调处理
+ */
+class TimerQueue : nocopyable {
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // 添加定时器，线程安全，在loop线程中调用时直接插入
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    // 取消定时器，线程安全
+    void cancel(TimerId timerId);
+
+private:
+    using Entry = std::pair<Timestamp, Timer *>;
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer *, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+    // timerfd可读，处理所有超时的定时器
+    void handleRead();
+    // 取出所有超时的定时器
+    std::vector<Entry> getExpired(Timestamp now);
+    // 重复的定时器重新插入
+    void reset(const std::vector<Entry> &expired, Timestamp now);
+    // 插入定时器，返回最早超时的定时器是否改变
+    bool insert(Timer *timer);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+    TimerList timers_;  // 按超时时间排序
+
+    // 按Timer地址排序，用于cancel
+    ActiveTimerSet activeTimers_;
+    std::atomic_bool callingExpiredTimers_;
+    ActiveTimerSet cancelingTimers_;  // 在回调中被取消的定时器
+};
@@ -1,5 +1,6 @@
 #include "Timestamp.h"
 
+#include <sys/time.h>
 #include <time.h>
 
 Timestamp::Timestamp() : microSecondsSinceEpoch_(0) {}
@@ -7,19 +8,23 @@ Timestamp::Timestamp() : microSecondsSinceEpoch_(0) {}
 Timestamp::Timestamp(int64_t microSecondsSinceEpoch) : microSecondsSinceEpoch_(microSecondsSinceEpoch) {}
 
 Timestamp Timestamp::now() {
-    return Timestamp(time(NULL));
+    struct timeval tv;
+    ::gettimeofday(&tv, NULL);
+    return Timestamp(static_cast<int64_t>(tv.tv_sec) * kMicroSecondsPerSecond + tv.tv_usec);
 }
 
 std::string Timestamp::toString() const {
     char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
+    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
+    tm tm_time;
+    localtime_r(&seconds, &tm_time);
     snprintf(buf, 128, "%4d-%02d-%02d %02d:%02d:%02d",
-             tm_time->tm_year + 1900,
-             tm_time->tm_mon + 1,
-             tm_time->tm_mday,
-             tm_time->tm_hour,
-             tm_time->tm_min,
-             tm_time->tm_sec);
+             tm_time.tm_year + 1900,
+             tm_time.tm_mon + 1,
+             tm_time.tm_mday,
+             tm_time.tm_hour,
+             tm_time.tm_min,
+             tm_time.tm_sec);
     return buf;
 }
 
@@ -27,4 +32,4 @@ std::string Timestamp::toString() const {
 // int main() {
 //     std::cout << Timestamp::now().toString() << std::endl;
 //     return 0;
-// }
\ No newline at end of file
+// }
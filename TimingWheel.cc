@@ -0,0 +1,111 @@
+#include "TimingWheel.h"
+
+#include <math.h>
+
+#include <functional>
+
+#include "EventLoop.h"
+
+void TimingWheel::Entry::unlink() {
+    if (wheel_) {
+        prev_->next_ = next_;
+        next_->prev_ = prev_;
+        prev_ = next_ = nullptr;
+        --wheel_->size_;
+        wheel_ = nullptr;
+    }
+}
+
+TimingWheel::TimingWheel(EventLoop *loop, double tickSeconds, size_t numSlots)
+    : loop_(loop)
+    , tickSeconds_(tickSeconds)
+    , mask_(numSlots - 1)
+    , slots_(new Entry[numSlots])
+    , currentTick_(0)
+    , size_(0)
+    , ticking_(false) {
+    for (size_t i = 0; i < numSlots; ++i) {
+        slots_[i].prev_ = slots_[i].next_ = &slots_[i];
+    }
+}
+
+TimingWheel::~TimingWheel() {
+    // 时间轮先于条目销毁时，把条目摘下来，避免条目析构时访问时间轮
+    for (size_t i = 0; i <= mask_; ++i) {
+        Entry &head = slots_[i];
+        while (head.next_ != &head) {
+            head.next_->unlink();
+        }
+    }
+    if (ticking_) {
+        loop_->cancel(tickTimer_);
+    }
+}
+
+uint64_t TimingWheel::ticksFor(double seconds) const {
+    uint64_t ticks = static_cast<uint64_t>(ceil(seconds / tickSeconds_));
+    return ticks > 0 ? ticks : 1;
+}
+
+void TimingWheel::schedule(Entry *entry, uint64_t ticks) {
+    entry->unlink();
+    entry->expireTick_ = currentTick_ + (ticks > 0 ? ticks : 1);
+    entry->wheel_ = this;
+    ++size_;
+    link(entry);
+
+    if (!ticking_) {
+        ticking_ = true;
+        tickTimer_ = loop_->runEvery(tickSeconds_, std::bind(&TimingWheel::onTick, this));
+    }
+}
+
+// 挂到超时tick对应槽位的链表尾部
+void TimingWheel::link(Entry *entry) {
+    Entry &head = slots_[entry->expireTick_ & mask_];
+    entry->prev_ = head.prev_;
+    entry->next_ = &head;
+    head.prev_->next_ = entry;
+    head.prev_ = entry;
+}
+
+void TimingWheel::onTick() {
+    ++currentTick_;
+    Entry &head = slots_[currentTick_ & mask_];
+
+    // 先把整个槽位摘到临时链表上，回调中可能重新调度或者删除其他条目
+    Entry pending;
+    if (head.next_ != &head) {
+        pending.next_ = head.next_;
+        pending.prev_ = head.prev_;
+        pending.next_->prev_ = &pending;
+        pending.prev_->next_ = &pending;
+        head.next_ = head.prev_ = &head;
+    } else {
+        pending.next_ = pending.prev_ = &pending;
+    }
+
+    while (pending.next_ != &pending) {
+        Entry *entry = pending.next_;
+        pending.next_ = entry->next_;
+        entry->next_->prev_ = &pending;
+
+        if (entry->expireTick_ > currentTick_) {
+            // 超时时间超过了一圈，放回原来的槽位等待下一圈
+            link(entry);
+        } else {
+            entry->prev_ = entry->next_ = nullptr;
+            entry->wheel_ = nullptr;
+            --size_;
+            if (entry->callback_) {
+                entry->callback_();
+            }
+        }
+    }
+
+    // 时间轮上已经没有条目了，停止tick，空闲的loop不会被定时唤醒
+    if (size_ == 0 && ticking_) {
+        ticking_ = false;
+        loop_->cancel(tickTimer_);
+    }
+}
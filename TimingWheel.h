@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+
+#include "InlineFunction.h"
+#include "TimerId.h"
+#include "nocopyable.h"
+
+class EventLoop;
+
+/**
+ * 哈希时间轮，用于管理海量连接的空闲超时、写超时
+ * 每个槽位是一个侵入式双向链表，插入、删除都是O(1)，不需要额外分配内存
+ * 时间轮由所属EventLoop的定时器驱动，每个tick只处理一个槽位，没有条目时停止tick
+ */
+class TimingWheel : nocopyable {
+public:
+    using Callback = InlineFunction<void()>;
+
+    // 挂在时间轮上的条目，嵌入在使用者(如TCPConnection)中，时间轮不管理其生命周期
+    class Entry : nocopyable {
+    public:
+        explicit Entry(Callback cb = Callback()) : callback_(std::move(cb)) {}
+        ~Entry() { unlink(); }
+
+        void setCallback(Callback cb) { callback_ = std::move(cb); }
+        bool linked() const { return wheel_ != nullptr; }
+
+    private:
+        friend class TimingWheel;
+        void unlink();
+
+        Entry *prev_{nullptr};
+        Entry *next_{nullptr};
+        TimingWheel *wheel_{nullptr};  // 所在的时间轮，为空表示不在时间轮上
+        uint64_t expireTick_{0};       // 超时的tick
+        Callback callback_;
+    };
+
+    // numSlots必须是2的幂
+    TimingWheel(EventLoop *loop, double tickSeconds = 1.0, size_t numSlots = 512);
+    ~TimingWheel();
+
+    // ticks个tick之后执行entry的回调，entry已经在时间轮上时重新调度
+    void schedule(Entry *entry, uint64_t ticks);
+    // 把entry从时间轮上删除
+    void cancel(Entry *entry) { entry->unlink(); }
+
+    // 当前的tick数，可以作为粗粒度的时钟，读取没有任何系统调用
+    uint64_t now() const { return currentTick_; }
+    // 秒数换算成tick数，向上取整，至少为1
+    uint64_t ticksFor(double seconds) const;
+    size_t size() const { return size_; }
+
+private:
+    void link(Entry *entry);
+    void onTick();
+
+    EventLoop *loop_;
+    const double tickSeconds_;
+    const size_t mask_;
+    std::unique_ptr<Entry[]> slots_;  // 每个槽位链表的哨兵节点
+
+    uint64_t currentTick_;
+    size_t size_;     // 时间轮上的条目个数
+    bool ticking_;    // tick定时器是否在运行
+    TimerId tickTimer_;
+};
@@ -0,0 +1,124 @@
+#include <dlfcn.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+
+// 短连接的建立速率，比较单acceptor、每个loop一个SO_REUSEPORT acceptor和EPOLLEXCLUSIVE共享监听socket
+// 同时统计每个连接平均的epoll_wait次数
+// steer: reuseport，subloop依次绑定到各个cpu上，按照SO_INCOMING_CPU由BPF程序选择监听socket
+// 用法: accept_bench [single|reuseport|shared|steer] [loops] [client threads] [seconds]
+
+// 统计所有loop的epoll_wait次数，覆盖libc中的同名函数
+std::atomic<long> g_epollWaits(0);
+
+extern "C" int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout) {
+    typedef int (*Func)(int, struct epoll_event *, int, int);
+    static Func real = reinterpret_cast<Func>(dlsym(RTLD_NEXT, "epoll_wait"));
+    ++g_epollWaits;
+    return real(epfd, events, maxevents, timeout);
+}
+
+namespace {
+
+const int kMaxLoops = 64;
+std::atomic<long> g_accepted[kMaxLoops];
+std::vector<EventLoop *> g_loops;
+
+void onConnection(const TCPConnectionPtr &conn) {
+    if (!conn->connected()) {
+        return;
+    }
+    for (size_t i = 0; i < g_loops.size(); ++i) {
+        if (g_loops[i] == conn->getLoop()) {
+            ++g_accepted[i];
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "reuseport";
+    int numLoops = argc > 2 ? atoi(argv[2]) : 4;
+    int numClients = argc > 3 ? atoi(argv[3]) : 4;
+    int seconds = argc > 4 ? atoi(argv[4]) : 5;
+    const uint16_t port = 9994;
+    Logger::setLogLevel(ERROR);
+
+    TCPServer::Option option = TCPServer::kNoReusePort;
+    if (mode == "reuseport" || mode == "steer") {
+        option = TCPServer::kReusePort;
+    } else if (mode == "shared") {
+        option = TCPServer::kSharedListener;
+    }
+
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(port), "accept", option);
+    server.setThreadNum(numLoops);
+    if (mode == "steer") {
+        std::vector<int> cpus;
+        for (long cpu = 0; cpu < ::sysconf(_SC_NPROCESSORS_ONLN); ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+        server.setCpuAffinity(cpus);
+        server.setIncomingCpuSteering(true);
+    }
+    server.setThreadInitCallback([](EventLoop *loop) {
+        // 线程池启动时依次初始化每个loop，不会并发调用
+        g_loops.push_back(loop);
+    });
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback([](const TCPConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    server.start();
+    usleep(200000);
+
+    long startWaits = g_epollWaits;
+    std::atomic_bool running(true);
+    std::vector<std::thread> clients;
+    InetAddress addr(port);
+    for (int i = 0; i < numClients; ++i) {
+        clients.emplace_back([&] {
+            struct linger lg = {1, 0};  // 直接发送RST，避免客户端端口被TIME_WAIT耗尽
+            while (running) {
+                int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) == 0) {
+                    ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+                }
+                ::close(fd);
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    running = false;
+    for (std::thread &t : clients) {
+        t.join();
+    }
+    long waits = g_epollWaits - startWaits;
+    usleep(200000);
+
+    long total = 0;
+    std::string perLoop;
+    for (size_t i = 0; i < g_loops.size(); ++i) {
+        total += g_accepted[i];
+        perLoop += " " + std::to_string(g_accepted[i].load());
+    }
+    printf("%-9s loops=%d clients=%d %8.0f conns/s %5.2f epoll_wait/conn, per loop:%s\n",
+           mode.c_str(), numLoops, numClients, static_cast<double>(total) / seconds,
+           total > 0 ? static_cast<double>(waits) / total : 0.0, perLoop.c_str());
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <string>
+
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+
+// 统计全局的内存分配次数
+std::atomic<long> g_allocs(0);
+
+void *operator new(size_t size) {
+    ++g_allocs;
+    void *p = malloc(size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+std::mutex g_mutex;
+std::condition_variable g_cond;
+int g_up = 0;
+int g_down = 0;
+TCPConnectionPtr g_conn;
+
+void onConnection(const TCPConnectionPtr &conn) {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    if (conn->connected()) {
+        ++g_up;
+        g_conn = conn;
+    } else {
+        ++g_down;
+        g_conn.reset();
+    }
+    g_cond.notify_all();
+}
+
+int connectTo(uint16_t port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(port);
+    if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    return fd;
+}
+
+void waitFor(int &counter, int value) {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    while (counter < value) {
+        g_cond.wait(lock);
+    }
+}
+
+// 统计每个连接(建立到关闭)以及每次跨线程send的内存分配次数
+// 用法: alloc_bench [connections] [sends]
+int main(int argc, char *argv[]) {
+    int numConns = argc > 1 ? atoi(argv[1]) : 1000;
+    int numSends = argc > 2 ? atoi(argv[2]) : 1000;
+    const uint16_t port = 9982;
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(port), "AllocBench");
+    server.setConnectionCallback(onConnection);
+    server.setThreadNum(1);
+    server.start();
+
+    // 预热，让各个容器完成扩容
+    for (int i = 0; i < 10; ++i) {
+        int fd = connectTo(port);
+        waitFor(g_up, i + 1);
+        ::close(fd);
+        waitFor(g_down, i + 1);
+    }
+
+    long before = g_allocs;
+    for (int i = 0; i < numConns; ++i) {
+        int fd = connectTo(port);
+        waitFor(g_up, 10 + i + 1);
+        ::close(fd);
+        waitFor(g_down, 10 + i + 1);
+    }
+    long perConn = g_allocs - before;
+    printf("allocations per connection (accept to close): %.2f\n", static_cast<double>(perConn) / numConns);
+
+    int fd = connectTo(port);
+    waitFor(g_up, 10 + numConns + 1);
+    TCPConnectionPtr conn;
+    {
+        std::unique_lock<std::mutex> lock(g_mutex);
+        conn = g_conn;
+    }
+
+    static const std::string message(16, 'x');
+    const int kBatch = 100;
+    before = g_allocs;
+    for (int i = 0; i < numSends; i += kBatch) {
+        for (int j = 0; j < kBatch; ++j) {
+            conn->send(message);
+        }
+        // 客户端读完这一批数据，说明loop已经执行完这一批send
+        size_t expected = message.size() * kBatch;
+        char buf[65536];
+        while (expected > 0) {
+            ssize_t n = ::read(fd, buf, sizeof(buf));
+            if (n <= 0) {
+                break;
+            }
+            expected -= n;
+        }
+    }
+    long perSend = g_allocs - before;
+    printf("allocations per cross-thread send: %.2f\n", static_cast<double>(perSend) / numSends);
+
+    conn.reset();
+    ::close(fd);
+    waitFor(g_down, 10 + numConns + 1);
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../BufferPool.h"
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+
+// 突发的大消息处理完之后连接占用的内存
+// 每个连接依次发送一条带4字节长度头的大消息，服务端收齐之后才取走并回复1个字节
+// 接收缓冲区会扩容到消息的大小，统计所有消息处理完之后进程的RSS和loop内存池的命中情况
+// 用法: buffer_bench [connections] [message KiB]
+
+namespace {
+
+EventLoop *g_loop = nullptr;
+
+long residentKiB() {
+    long pages = 0, resident = 0;
+    FILE *fp = ::fopen("/proc/self/statm", "r");
+    if (fp) {
+        if (::fscanf(fp, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        ::fclose(fp);
+    }
+    return resident * (::sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void onMessage(const TCPConnectionPtr &conn, Buffer *buf, Timestamp) {
+    while (buf->readableBytes() >= sizeof(uint32_t)) {
+        uint32_t len = 0;
+        ::memcpy(&len, buf->peek(), sizeof len);
+        len = ntohl(len);
+        if (buf->readableBytes() < sizeof(uint32_t) + len) {
+            break;
+        }
+        buf->retrieve(sizeof(uint32_t) + len);
+        conn->send("k", 1);
+    }
+}
+
+bool writeAll(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    int numConns = argc > 1 ? atoi(argv[1]) : 64;
+    size_t msgBytes = static_cast<size_t>(argc > 2 ? atoi(argv[2]) : 4096) * 1024;
+    const uint16_t port = 9995;
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(port), "buffer");
+    server.setThreadNum(1);
+    server.setThreadInitCallback([](EventLoop *loop) { g_loop = loop; });
+    server.setConnectionCallback([](const TCPConnectionPtr &) {});
+    server.setMessageCallback(onMessage);
+    server.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<int> fds;
+    InetAddress addr(port);
+    for (int i = 0; i < numConns; ++i) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+            perror("connect");
+            return 1;
+        }
+        fds.push_back(fd);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    long idleRss = residentKiB();
+
+    std::string message(sizeof(uint32_t) + msgBytes, 'm');
+    uint32_t len = htonl(static_cast<uint32_t>(msgBytes));
+    ::memcpy(&message[0], &len, sizeof len);
+    auto start = std::chrono::steady_clock::now();
+    for (int fd : fds) {
+        char ack;
+        if (!writeAll(fd, message.data(), message.size()) || ::read(fd, &ack, 1) != 1) {
+            perror("echo");
+            return 1;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long burstRss = residentKiB();
+
+    BufferPool::Stats stats = g_loop->bufferPool()->stats();
+    printf("connections=%d message=%zu KiB %7.1f MiB/s\n", numConns, msgBytes / 1024,
+           numConns * msgBytes / seconds / 1024 / 1024);
+    printf("rss idle: %ld KiB, after burst: %ld KiB (%+ld KiB)\n", idleRss, burstRss, burstRss - idleRss);
+    printf("pool hits: %lu misses: %lu releases: %lu drops: %lu cached: %zu KiB\n", stats.hits, stats.misses,
+           stats.releases, stats.drops, stats.cachedBytes / 1024);
+
+    for (int fd : fds) {
+        ::close(fd);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <dlfcn.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+
+// 统计epoll系统调用的次数，覆盖libc中的同名函数
+std::atomic<long> g_epollWaits(0);
+std::atomic<long> g_epollCtls(0);
+
+extern "C" int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout) {
+    typedef int (*Func)(int, struct epoll_event *, int, int);
+    static Func real = reinterpret_cast<Func>(dlsym(RTLD_NEXT, "epoll_wait"));
+    ++g_epollWaits;
+    return real(epfd, events, maxevents, timeout);
+}
+
+extern "C" int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) {
+    typedef int (*Func)(int, int, int, struct epoll_event *);
+    static Func real = reinterpret_cast<Func>(dlsym(RTLD_NEXT, "epoll_ctl"));
+    ++g_epollCtls;
+    return real(epfd, op, fd, event);
+}
+
+std::mutex g_mutex;
+std::condition_variable g_cond;
+TCPConnectionPtr g_conn;
+long g_received = 0;  // 服务端收到的字节数，只在loop线程中修改
+long g_sent = 0;      // 服务端已经交给send的字节数
+bool g_done = false;
+
+const size_t kChunk = 64 * 1024;
+
+void onConnection(const TCPConnectionPtr &conn) {
+    std::unique_lock<std::mutex> lock(g_mutex);
+    g_conn = conn->connected() ? conn : TCPConnectionPtr();
+    g_cond.notify_all();
+}
+
+// 大块数据的单向传输: 先由客户端上传，再由服务端下载，统计epoll_wait和epoll_ctl的次数
+// 用法: bulk_bench [lt|et] [MiB]
+int main(int argc, char *argv[]) {
+    bool edgeTriggered = argc > 1 && strcmp(argv[1], "et") == 0;
+    long total = (argc > 2 ? atol(argv[2]) : 256) * 1024 * 1024;
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(9993), "bulk");
+    server.setThreadNum(1);
+    server.setEdgeTriggered(edgeTriggered);
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback([total](const TCPConnectionPtr &, Buffer *buf, Timestamp) {
+        g_received += buf->readableBytes();
+        buf->retrieveAll();
+        if (g_received == total) {
+            std::unique_lock<std::mutex> lock(g_mutex);
+            g_done = true;
+            g_cond.notify_all();
+        }
+    });
+    server.setWriteCompleteCallback([total](const TCPConnectionPtr &conn) {
+        if (g_sent > 0 && g_sent < total) {
+            g_sent += kChunk;
+            conn->send(std::string(kChunk, 'd'));
+        }
+    });
+    server.start();
+    usleep(100000);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(9993);
+    if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+        perror("connect");
+        return 1;
+    }
+    TCPConnectionPtr conn;
+    {
+        std::unique_lock<std::mutex> lock(g_mutex);
+        while (!g_conn) {
+            g_cond.wait(lock);
+        }
+        conn = g_conn;
+    }
+
+    // 上传
+    std::string chunk(kChunk, 'u');
+    long waits = g_epollWaits, ctls = g_epollCtls;
+    auto start = std::chrono::steady_clock::now();
+    for (long sent = 0; sent < total; sent += kChunk) {
+        ::write(fd, chunk.data(), chunk.size());
+    }
+    {
+        std::unique_lock<std::mutex> lock(g_mutex);
+        while (!g_done) {
+            g_cond.wait(lock);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%s upload:   %7.1f MiB/s epoll_wait=%ld epoll_ctl=%ld\n", edgeTriggered ? "et" : "lt",
+           total / seconds / 1024 / 1024, g_epollWaits - waits, g_epollCtls - ctls);
+
+    // 下载，每发送完一块再发送下一块
+    waits = g_epollWaits, ctls = g_epollCtls;
+    start = std::chrono::steady_clock::now();
+    conn->getLoop()->runInLoop([conn] {
+        g_sent = kChunk;
+        conn->send(std::string(kChunk, 'd'));
+    });
+    char buf[kChunk];
+    for (long received = 0; received < total;) {
+        ssize_t n = ::read(fd, buf, sizeof buf);
+        if (n <= 0) {
+            break;
+        }
+        received += n;
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%s download: %7.1f MiB/s epoll_wait=%ld epoll_ctl=%ld\n", edgeTriggered ? "et" : "lt",
+           total / seconds / 1024 / 1024, g_epollWaits - waits, g_epollCtls - ctls);
+
+    conn.reset();
+    ::close(fd);
+    usleep(100000);
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <dlfcn.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+
+// 短连接的吞吐，每个连接从accept到关闭的代价
+// 客户端连接之后发送一条消息，服务端回显之后shutdown，客户端读到EOF之后关闭，和echo示例的用法一样
+// 同时统计每个连接平均的getsockname/setsockopt次数(客户端不调用这两个函数)
+// loopback: 监听127.0.0.1，本地地址直接使用监听地址；any: 监听0.0.0.0，本地地址用到时才获取
+// 用法: churn_bench [loopback|any] [loops] [client threads] [seconds]
+
+std::atomic<long> g_getsocknames(0);
+std::atomic<long> g_setsockopts(0);
+
+extern "C" int getsockname(int fd, struct sockaddr *addr, socklen_t *len) {
+    typedef int (*Func)(int, struct sockaddr *, socklen_t *);
+    static Func real = reinterpret_cast<Func>(dlsym(RTLD_NEXT, "getsockname"));
+    ++g_getsocknames;
+    return real(fd, addr, len);
+}
+
+extern "C" int setsockopt(int fd, int level, int name, const void *value, socklen_t len) {
+    typedef int (*Func)(int, int, int, const void *, socklen_t);
+    static Func real = reinterpret_cast<Func>(dlsym(RTLD_NEXT, "setsockopt"));
+    ++g_setsockopts;
+    return real(fd, level, name, value, len);
+}
+
+namespace {
+
+std::atomic<long> g_closed(0);
+
+void onConnection(const TCPConnectionPtr &conn) {
+    if (!conn->connected()) {
+        ++g_closed;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "loopback";
+    int numLoops = argc > 2 ? atoi(argv[2]) : 2;
+    int numClients = argc > 3 ? atoi(argv[3]) : 4;
+    int seconds = argc > 4 ? atoi(argv[4]) : 5;
+    const uint16_t port = 9983;
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    InetAddress listenAddr(port, mode == "any" ? "0.0.0.0" : "127.0.0.1");
+    TCPServer server(baseLoop, listenAddr, "churn");
+    server.setThreadNum(numLoops);
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback([](const TCPConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+        conn->shutdown();
+    });
+    server.start();
+    usleep(200000);
+
+    long startGetsocknames = g_getsocknames;
+    long startSetsockopts = g_setsockopts;
+    long startClosed = g_closed;
+    std::atomic_bool running(true);
+    std::vector<std::thread> clients;
+    InetAddress addr(port);
+    for (int i = 0; i < numClients; ++i) {
+        clients.emplace_back([&] {
+            char buf[64];
+            while (running) {
+                int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) == 0 &&
+                    ::write(fd, "hello", 5) == 5) {
+                    while (::read(fd, buf, sizeof(buf)) > 0) {
+                    }
+                }
+                ::close(fd);
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    running = false;
+    for (std::thread &t : clients) {
+        t.join();
+    }
+    usleep(200000);
+
+    long closed = g_closed - startClosed;
+    long getsocknames = g_getsocknames - startGetsocknames;
+    long setsockopts = g_setsockopts - startSetsockopts;
+    printf("%-8s loops=%d clients=%d %8.0f conns/s %5.2f getsockname/conn %5.2f setsockopt/conn\n",
+           mode.c_str(), numLoops, numClients, static_cast<double>(closed) / seconds,
+           closed > 0 ? static_cast<double>(getsocknames) / closed : 0.0,
+           closed > 0 ? static_cast<double>(setsockopts) / closed : 0.0);
+    return 0;
+}
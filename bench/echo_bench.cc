@@ -0,0 +1,156 @@
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Channel.h"
+#include "../EventLoop.h"
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+
+// ping-pong回显测试，比较epoll和io_uring两种IO复用的吞吐量
+// 服务端一个subloop使用指定的IO复用，客户端在另一个loop中使用epoll
+// 用法: echo_bench [epoll|iouring|both] [connections] [seconds] [message size]
+
+// 统计服务端subloop每个请求的epoll_ctl次数，覆盖libc中的同名函数
+std::atomic<long> g_epollCtls(0);
+
+extern "C" int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) {
+    typedef int (*Func)(int, int, int, struct epoll_event *);
+    static Func real = reinterpret_cast<Func>(dlsym(RTLD_NEXT, "epoll_ctl"));
+    ++g_epollCtls;
+    return real(epfd, op, fd, event);
+}
+
+namespace {
+
+struct Client {
+    int fd;
+    std::unique_ptr<Channel> channel;
+};
+
+long runBench(EventLoop::Backend backend, uint16_t port, int numConns, int seconds, int msgSize, double &ctlsPerMessage) {
+    EventLoopThread baseThread(EventLoopThread::ThreadInitCallback(), "base", EventLoop::kEPollBackend);
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(port), "echo");
+    server.setThreadNum(1);
+    server.setPollerBackend(backend);
+    server.setConnectionCallback([](const TCPConnectionPtr &) {});
+    server.setMessageCallback([](const TCPConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+    });
+    server.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    EventLoopThread clientThread(EventLoopThread::ThreadInitCallback(), "client", EventLoop::kEPollBackend);
+    EventLoop *clientLoop = clientThread.startLoop();
+
+    std::atomic_long bytes(0);
+    std::atomic_bool running(true);
+    std::vector<Client> clients(numConns);
+    std::string message(msgSize, 'x');
+    InetAddress addr(port);
+    for (Client &c : clients) {
+        c.fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(c.fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+            perror("connect");
+            exit(1);
+        }
+        ::fcntl(c.fd, F_SETFL, O_NONBLOCK);
+    }
+
+    clientLoop->runInLoop([&] {
+        for (Client &c : clients) {
+            int fd = c.fd;
+            c.channel.reset(new Channel(clientLoop, fd));
+            c.channel->setReadCallback([fd, &bytes, &running](Timestamp) {
+                char buf[65536];
+                ssize_t n = ::read(fd, buf, sizeof buf);
+                if (n > 0 && running) {
+                    bytes += n;
+                    ::write(fd, buf, n);
+                }
+            });
+            c.channel->enableReading();
+            ::write(fd, message.data(), message.size());
+        }
+    });
+
+    // 只统计稳定运行期间的调用，不包括建立连接
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    long startBytes = bytes;
+    long startCtls = g_epollCtls;
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    long result = bytes - startBytes;
+    ctlsPerMessage = static_cast<double>(g_epollCtls - startCtls) / (static_cast<double>(result) / msgSize);
+    // 先停止回显，等连接上的数据都处理完之后再关闭
+    running = false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    clientLoop->runInLoop([&] {
+        for (Client &c : clients) {
+            c.channel->disableAll();
+            c.channel->remove();
+            ::close(c.fd);
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return result;
+}
+
+void report(const char *name, long bytes, int seconds, int msgSize, double ctlsPerMessage) {
+    printf("%-8s %10.0f msgs/s %8.2f MiB/s %6.3f epoll_ctl/msg\n", name,
+           static_cast<double>(bytes) / msgSize / seconds,
+           static_cast<double>(bytes) / seconds / 1024 / 1024, ctlsPerMessage);
+    fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    std::string which = argc > 1 ? argv[1] : "both";
+    int numConns = argc > 2 ? atoi(argv[2]) : 100;
+    int seconds = argc > 3 ? atoi(argv[3]) : 5;
+    int msgSize = argc > 4 ? atoi(argv[4]) : 64;
+    Logger::setLogLevel(ERROR);
+
+    struct Run {
+        const char *name;
+        EventLoop::Backend backend;
+        uint16_t port;
+    } runs[] = {
+        {"epoll", EventLoop::kEPollBackend, 9991},
+        {"iouring", EventLoop::kIoUringBackend, 9992},
+    };
+
+    printf("connections=%d seconds=%d message=%d bytes\n", numConns, seconds, msgSize);
+    fflush(stdout);
+    for (const Run &run : runs) {
+        if (which != "both" && which != run.name) {
+            continue;
+        }
+        // 每个后端在单独的子进程中运行，互不影响
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            double ctlsPerMessage = 0;
+            long bytes = runBench(run.backend, run.port, numConns, seconds, msgSize, ctlsPerMessage);
+            report(run.name, bytes, seconds, msgSize, ctlsPerMessage);
+            _exit(0);
+        }
+        ::waitpid(pid, nullptr, 0);
+    }
+    return 0;
+}
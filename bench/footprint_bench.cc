@@ -0,0 +1,142 @@
+#include <malloc.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+
+// 空闲连接的内存占用: 建立connections个不收发数据的连接，统计服务端每个连接的内存分配次数和占用的堆内存
+// 堆内存来自mallinfo2，包括连接对象、连接表项等，不包括内核socket的内存
+// 客户端和服务端在同一个进程中，每个连接需要两个fd，会尝试把RLIMIT_NOFILE提高到需要的值
+// 用法: footprint_bench [connections]
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+// 统计所有线程的内存分配次数，覆盖libc中的同名函数
+std::atomic<long> g_allocs(0);
+
+void *malloc(size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+}
+
+namespace {
+
+std::atomic<int> g_up(0);
+
+size_t heapBytes() {
+    struct mallinfo2 info = ::mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+bool raiseFdLimit(rlim_t wanted) {
+    struct rlimit limit;
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur >= wanted) {
+        return true;
+    }
+    if (limit.rlim_max < wanted) {
+        limit.rlim_max = wanted;  // root可以提高硬限制，不超过fs.nr_open
+    }
+    limit.rlim_cur = wanted;
+    return ::setrlimit(RLIMIT_NOFILE, &limit) == 0;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    int numConns = argc > 1 ? atoi(argv[1]) : 10000;
+    const uint16_t port = 9997;
+    Logger::setLogLevel(ERROR);
+
+    if (!raiseFdLimit(static_cast<rlim_t>(numConns) * 2 + 64)) {
+        struct rlimit limit;
+        ::getrlimit(RLIMIT_NOFILE, &limit);
+        numConns = static_cast<int>((limit.rlim_cur - 64) / 2);
+        printf("RLIMIT_NOFILE too small, connections reduced to %d\n", numConns);
+    }
+
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(port), "footprint");
+    server.setThreadNum(1);
+    server.setConnectionCallback([](const TCPConnectionPtr &conn) {
+        if (conn->connected()) {
+            ++g_up;
+        }
+    });
+    server.setMessageCallback([](const TCPConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    server.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<int> fds;
+    fds.reserve(numConns);
+    InetAddress addr(port);
+    // 预热，让loop和server中的容器完成第一次扩容
+    const int kWarmup = 16;
+    for (int i = 0; i < kWarmup; ++i) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        ::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in));
+        fds.push_back(fd);
+    }
+    while (g_up < kWarmup) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    long allocs = g_allocs;
+    size_t bytes = heapBytes();
+    for (int i = kWarmup; i < numConns; ++i) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+            perror("connect");
+            return 1;
+        }
+        fds.push_back(fd);
+    }
+    while (g_up < numConns) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // 等待还在路上的回调执行完
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    double measured = numConns - kWarmup;
+    printf("connections=%d sizeof(TCPConnection)=%zu\n", numConns, sizeof(TCPConnection));
+    printf("per idle connection: %.2f allocations, %.0f heap bytes\n", (g_allocs - allocs) / measured,
+           (heapBytes() - bytes) / measured);
+
+    for (int fd : fds) {
+        ::close(fd);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    return 0;
+}
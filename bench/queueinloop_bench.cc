@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../EventLoop.h"
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+
+// 多个线程向同一个loop投递任务，测试跨线程任务的吞吐量
+// 用法: queueinloop_bench [producers] [tasks per producer]
+int main(int argc, char *argv[]) {
+    int numProducers = argc > 1 ? atoi(argv[1]) : 4;
+    int numTasks = argc > 2 ? atoi(argv[2]) : 1000000;
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+
+    const long total = static_cast<long>(numProducers) * numTasks;
+    long executed = 0;  // 只在loop线程中修改
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done = false;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (int i = 0; i < numProducers; ++i) {
+        producers.emplace_back([&] {
+            for (int j = 0; j < numTasks; ++j) {
+                loop->queueInLoop([&] {
+                    if (++executed == total) {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        done = true;
+                        cond.notify_one();
+                    }
+                });
+            }
+        });
+    }
+    for (std::thread &t : producers) {
+        t.join();
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!done) {
+            cond.wait(lock);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    printf("producers=%d tasks=%ld time=%.3fs throughput=%.0f tasks/s\n",
+           numProducers, total, seconds, total / seconds);
+    return 0;
+}
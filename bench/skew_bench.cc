@@ -0,0 +1,215 @@
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "../EventLoopThread.h"
+#include "../LoopSelector.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+
+// 负载不均衡时不同loop选择策略下轻量请求的尾延迟
+// 连接按照"1个重连接 + (2*loops-1)个轻连接"的顺序分批建立
+// 轮询时所有重连接都会和一部分轻连接落在同一个loop上，每批连接之后各个loop的连接数相同，最少连接数也是如此
+// 重连接: 服务端持续生成并发送大块数据，每块都会占用loop一段时间，客户端限速读取，发送队列一直有积压
+// 轻连接: 每2ms一次64字节的ping-pong，统计往返延迟
+// rb为轮询加上定期迁移连接的rebalance
+// 用法: skew_bench [all|rr|lc|lpb|p2c|rb] [loops] [rounds] [seconds]
+namespace {
+
+const size_t kChunk = 256 * 1024;
+const uint16_t kPort = 9995;
+
+// 重连接的集合，连接可能被迁移到其他loop，需要加锁
+std::mutex g_heavyMutex;
+std::unordered_set<TCPConnection *> g_heavyConns;
+
+bool isHeavy(TCPConnection *conn) {
+    std::lock_guard<std::mutex> lock(g_heavyMutex);
+    return g_heavyConns.count(conn) > 0;
+}
+
+// 生成一块响应，模拟占用loop线程的处理(比如同步读磁盘)，占用的是loop的时间而不是CPU
+// 这样单核机器上也能体现出loop之间的不均衡
+std::string renderChunk() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    return std::string(kChunk, 'd');
+}
+
+void onConnection(const TCPConnectionPtr &conn) {
+    if (!conn->connected()) {
+        std::lock_guard<std::mutex> lock(g_heavyMutex);
+        g_heavyConns.erase(conn.get());
+    }
+}
+
+void onMessage(const TCPConnectionPtr &conn, Buffer *buf, Timestamp) {
+    std::string msg = buf->retrieveAllAsString();
+    if (msg[0] == 'H') {
+        {
+            std::lock_guard<std::mutex> lock(g_heavyMutex);
+            g_heavyConns.insert(conn.get());
+        }
+        conn->send(renderChunk());
+    } else {
+        conn->send(msg);
+    }
+}
+
+void onWriteComplete(const TCPConnectionPtr &conn) {
+    if (isHeavy(conn.get())) {
+        conn->send(renderChunk());
+    }
+}
+
+int connectServer() {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(kPort);
+    if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    int on = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    return fd;
+}
+
+void runBench(const char *name, LoopSelector::Policy policy, bool rebalance, int numLoops, int rounds, int seconds) {
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(kPort), "skew");
+    server.setThreadNum(numLoops);
+    server.setLoopSelectPolicy(policy);
+    if (rebalance) {
+        server.setRebalanceInterval(0.5);
+    }
+    std::vector<EventLoop *> loops;
+    server.setThreadInitCallback([&loops](EventLoop *loop) { loops.push_back(loop); });
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setWriteCompleteCallback(onWriteComplete);
+    server.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::atomic_bool running(true);
+    std::mutex mutex;
+    std::vector<double> latencies;  // 微秒
+    std::vector<std::thread> clients;
+    for (int r = 0; r < rounds; ++r) {
+        // 重连接开始发送之后再建立轻连接，让发送队列的积压反映到负载计数上
+        int heavyFd = connectServer();
+        clients.emplace_back([heavyFd, &running] {
+            ::write(heavyFd, "H", 1);
+            char buf[64 * 1024];
+            while (running) {
+                if (::read(heavyFd, buf, sizeof buf) <= 0) {
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+            ::close(heavyFd);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        for (int i = 0; i < 2 * numLoops - 1; ++i) {
+            int fd = connectServer();
+            clients.emplace_back([fd, &running, &mutex, &latencies] {
+                std::vector<double> local;
+                char buf[64];
+                memset(buf, 'p', sizeof buf);
+                while (running) {
+                    auto start = std::chrono::steady_clock::now();
+                    ::write(fd, buf, sizeof buf);
+                    size_t got = 0;
+                    while (got < sizeof buf) {
+                        ssize_t n = ::read(fd, buf + got, sizeof buf - got);
+                        if (n <= 0) {
+                            ::close(fd);
+                            return;
+                        }
+                        got += n;
+                    }
+                    local.push_back(std::chrono::duration<double, std::micro>(
+                        std::chrono::steady_clock::now() - start).count());
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                }
+                ::close(fd);
+                std::lock_guard<std::mutex> lock(mutex);
+                latencies.insert(latencies.end(), local.begin(), local.end());
+            });
+        }
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    std::string perLoop;
+    for (EventLoop *loop : loops) {
+        perLoop += " " + std::to_string(loop->numConnections()) + "/" +
+                   std::to_string(loop->pendingBytes() / 1024) + "K";
+    }
+    running = false;
+    for (std::thread &t : clients) {
+        t.join();
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    size_t n = latencies.size();
+    if (n == 0) {
+        printf("%-4s no samples\n", name);
+        return;
+    }
+    printf("%-4s samples=%-6zu p50=%8.0fus p99=%8.0fus p99.9=%8.0fus max=%8.0fus  conns/pending per loop:%s\n",
+           name, n, latencies[n / 2], latencies[n * 99 / 100], latencies[n * 999 / 1000], latencies[n - 1],
+           perLoop.c_str());
+    fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    std::string which = argc > 1 ? argv[1] : "all";
+    int numLoops = argc > 2 ? atoi(argv[2]) : 4;
+    int rounds = argc > 3 ? atoi(argv[3]) : 4;
+    int seconds = argc > 4 ? atoi(argv[4]) : 5;
+    Logger::setLogLevel(FATAL);
+
+    struct Run {
+        const char *name;
+        LoopSelector::Policy policy;
+        bool rebalance;
+    } runs[] = {
+        {"rr", LoopSelector::kRoundRobin, false},
+        {"lc", LoopSelector::kLeastConnections, false},
+        {"lpb", LoopSelector::kLeastPendingBytes, false},
+        {"p2c", LoopSelector::kPowerOfTwoChoices, false},
+        {"rb", LoopSelector::kRoundRobin, true},
+    };
+
+    printf("loops=%d heavy=%d light=%d seconds=%d\n", numLoops, rounds, rounds * (2 * numLoops - 1), seconds);
+    fflush(stdout);
+    for (const Run &run : runs) {
+        if (which != "all" && which != run.name) {
+            continue;
+        }
+        // 每个策略在单独的子进程中运行，互不影响
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            runBench(run.name, run.policy, run.rebalance, numLoops, rounds, seconds);
+            _exit(0);
+        }
+        ::waitpid(pid, nullptr, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <glob.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../AsyncLogging.h"
+#include "../Logger.h"
+
+AsyncLogging *g_asyncLog = nullptr;
+
+void asyncOutput(const char *msg, int len) {
+    g_asyncLog->append(msg, len);
+}
+
+void asyncFlush() {
+    g_asyncLog->flush();
+}
+
+// basename开头的所有日志文件中是否有marker
+bool logContains(const std::string &basename, const std::string &marker) {
+    glob_t files;
+    bool found = false;
+    if (::glob((basename + ".*").c_str(), 0, nullptr, &files) == 0) {
+        for (size_t i = 0; i < files.gl_pathc && !found; ++i) {
+            std::ifstream in(files.gl_pathv[i]);
+            std::stringstream content;
+            content << in.rdbuf();
+            found = content.str().find(marker) != std::string::npos;
+        }
+    }
+    ::globfree(&files);
+    return found;
+}
+
+int main(int argc, char *argv[]) {
+    std::string basename = argc > 1 ? argv[1] : "asynclogging_test";
+    bool ok = true;
+
+    // 子进程LOG_FATAL之后直接exit，安装了flush之后这条日志在exit之前已经写入文件
+    std::string fatalBasename = basename + "_fatal";
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        AsyncLogging log(fatalBasename, 1000 * 1000);
+        log.start();
+        g_asyncLog = &log;
+        Logger::setOutput(asyncOutput);
+        Logger::setFlush(asyncFlush);
+        LOG_FATAL("fatal marker from pid %d", ::getpid());
+    }
+    ::waitpid(pid, nullptr, 0);
+    bool fatalLogged = logContains(fatalBasename, "fatal marker from pid " + std::to_string(pid));
+    std::cout << "fatal message written before exit: " << (fatalLogged ? "yes" : "no") << std::endl;
+    ok = ok && fatalLogged;
+
+    AsyncLogging log(basename, 1000 * 1000);
+    log.start();
+    g_asyncLog = &log;
+    Logger::setOutput(asyncOutput);
+    Logger::setFlush(asyncFlush);
+
+    // 多个线程同时写日志，超过1M之后日志文件会滚动
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([i] {
+            for (int j = 0; j < 10000; ++j) {
+                LOG_INFO("thread %d write log message %d, padding padding padding", i, j);
+            }
+        });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    // ERROR日志会调用flush，返回时已经在文件中，不需要等后端的定时刷新
+    LOG_ERROR("error marker from pid %d", ::getpid());
+    bool errorLogged = logContains(basename, "error marker from pid " + std::to_string(::getpid()));
+    std::cout << "error message written after flush: " << (errorLogged ? "yes" : "no") << std::endl;
+    ok = ok && errorLogged;
+
+    log.stop();
+    std::cout << "dropped bytes: " << log.droppedBytes() << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+
+#include "../Buffer.h"
+#include "../BufferPool.h"
+#include "../EventLoop.h"
+
+namespace {
+
+void printStats(const char *when, BufferPool *pool) {
+    BufferPool::Stats stats = pool->stats();
+    printf("%-22s hits: %lu misses: %lu releases: %lu drops: %lu cached: %lu\n", when,
+           stats.hits, stats.misses, stats.releases, stats.drops, stats.cachedBytes);
+}
+
+}  // namespace
+
+int main() {
+    printf("chunkSizeFor: %lu %lu %lu %lu\n", BufferPool::chunkSizeFor(1),
+           BufferPool::chunkSizeFor(Buffer::kCheapPrepend + Buffer::kInitialSize),
+           BufferPool::chunkSizeFor(BufferPool::kMaxChunkSize),
+           BufferPool::chunkSizeFor(BufferPool::kMaxChunkSize + 1));
+
+    EventLoop loop;
+    BufferPool *pool = loop.bufferPool();
+
+    // 写入数据时才借内存，取完之后马上还回去
+    Buffer buf(pool);
+    printf("empty capacity: %lu\n", buf.capacity());
+    buf.append("hello", 5);
+    printf("after append capacity: %lu readable: %lu\n", buf.capacity(), buf.readableBytes());
+    buf.retrieveAll();
+    printf("after retrieveAll capacity: %lu\n", buf.capacity());
+    buf.append("world", 5);
+    printStats("reuse:", pool);
+    std::string str = buf.retrieveAllAsString();
+    printf("retrieveAsString: %s capacity: %lu\n", str.c_str(), buf.capacity());
+
+    // 突发的大块数据处理完之后还给pool
+    std::string burst(3 * 1024 * 1024, 'x');
+    buf.append(burst.data(), burst.size());
+    printf("burst capacity: %lu\n", buf.capacity());
+    buf.retrieve(burst.size() - 10);
+    buf.shrink();
+    printf("after shrink capacity: %lu readable: %lu\n", buf.capacity(), buf.readableBytes());
+    buf.retrieveAll();
+    printStats("after burst:", pool);
+
+    // readFd在没有内存时先借一块
+    int fds[2];
+    if (::pipe(fds) < 0) {
+        perror("pipe");
+        return 1;
+    }
+    ::write(fds[1], "from pipe", 9);
+    int saveErrno = 0;
+    ssize_t n = buf.readFd(fds[0], &saveErrno);
+    str = buf.retrieveAllAsString();
+    printf("readFd: %ld %s capacity: %lu\n", n, str.c_str(), buf.capacity());
+    ::close(fds[0]);
+    ::close(fds[1]);
+
+    // 拷贝和移动得到的缓冲区不使用pool
+    buf.append("copy", 4);
+    Buffer copy(buf);
+    Buffer moved(std::move(buf));
+    printf("copy: %s moved: %s source readable: %lu\n", copy.retrieveAllAsString().c_str(),
+           moved.retrieveAllAsString().c_str(), buf.readableBytes());
+
+    // 其他线程中借还不经过空闲链表
+    std::thread other([pool] {
+        size_t capacity = 0;
+        char *chunk = pool->acquire(4096, &capacity);
+        pool->release(chunk, capacity);
+    });
+    other.join();
+    printStats("after other thread:", pool);
+
+    pool->trim();
+    printStats("after trim:", pool);
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+#include "test_util.h"
+
+// 连接ID和按loop分片的连接表: 业务线程只保存连接ID，通过TCPServer::send发送数据
+TestSignal g_signal;
+// 以下状态通过g_signal.update修改
+std::map<uint16_t, uint64_t> g_ids;  // 客户端端口 -> 连接ID
+std::map<uint64_t, EventLoop *> g_closed;  // 已经关闭的连接ID -> 所在的loop
+
+int main() {
+    const uint16_t port = freePort();
+    const int kConns = 8;
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(port), "registry");
+    server.setThreadNum(3);
+    server.setConnectionCallback([](const TCPConnectionPtr &conn) {
+        g_signal.update([&conn] {
+            if (conn->connected()) {
+                g_ids[conn->peerAddress().toPort()] = conn->id();
+            } else {
+                g_closed[conn->id()] = conn->getLoop();
+            }
+        });
+    });
+    server.setMessageCallback([](const TCPConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    startServer(server, baseLoop);
+
+    std::vector<int> fds;
+    for (int i = 0; i < kConns; ++i) {
+        fds.push_back(connectServer(port));
+    }
+    g_signal.wait([] { return g_ids.size() == kConns; });
+    printf("connections: %lu\n", server.numConnections());
+
+    // ID不重复，按分片下标可以找到连接
+    bool ok = true;
+    std::map<uint64_t, int> seen;
+    for (int fd : fds) {
+        uint64_t id = g_ids[localPort(fd)];
+        ok = ok && seen.insert(std::make_pair(id, fd)).second;
+        TCPConnectionPtr conn = server.findConnection(id);
+        ok = ok && conn && conn->id() == id;
+    }
+    TCPConnectionPtr first = server.findConnection(g_ids[localPort(fds[0])]);
+    printf("unique ids and lookup: %s, name: %s\n", ok ? "ok" : "FAILED",
+           first->name().substr(0, first->name().find('#')).c_str());
+    first.reset();
+
+    // 在业务线程中只通过ID发送
+    std::thread sender([&] {
+        for (int fd : fds) {
+            uint64_t id = g_ids[localPort(fd)];
+            std::string message = "to#" + std::to_string(id);
+            server.send(id, message);
+        }
+    });
+    sender.join();
+    int received = 0;
+    for (int fd : fds) {
+        uint64_t id = g_ids[localPort(fd)];
+        std::string expected = "to#" + std::to_string(id);
+        char buf[64];
+        ssize_t n = ::read(fd, buf, sizeof buf);
+        if (n == static_cast<ssize_t>(expected.size()) && std::string(buf, n) == expected) {
+            ++received;
+        }
+    }
+    printf("send by id received: %d/%d\n", received, kConns);
+
+    // 关闭的连接在自己的loop中从分片中删除，之后按ID发送失败
+    uint64_t closedId = g_ids[localPort(fds[0])];
+    ::close(fds[0]);
+    EventLoop *closedLoop = nullptr;
+    g_signal.wait([closedId, &closedLoop] {
+        closedLoop = g_closed.count(closedId) ? g_closed[closedId] : nullptr;
+        return closedLoop != nullptr;
+    });
+    // 关闭回调之后handleClose才从分片中删除连接，在它的loop中同步一次
+    runInLoopAndWait(closedLoop, [] {});
+    printf("send to closed: %s, connections: %lu\n", server.send(closedId, "late") ? "sent" : "rejected",
+           server.numConnections());
+    printf("send to unknown: %s\n", server.send(closedId + 1000003, "none") ? "sent" : "rejected");
+
+    for (size_t i = 1; i < fds.size(); ++i) {
+        ::close(fds[i]);
+    }
+    g_signal.wait([] { return g_closed.size() == kConns; });
+    return 0;
+}
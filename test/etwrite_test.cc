@@ -0,0 +1,76 @@
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+#include "test_util.h"
+
+// 收到客户端的请求之后一次发送比IOV_MAX多的数据段，一次writev写不完，socket的发送缓冲区却还有空间
+// 边缘触发模式下不会再有EPOLLOUT，检查客户端在超时之前收到了全部数据
+// 用法: etwrite_test [lt|et] [epoll|iouring]
+int main(int argc, char *argv[]) {
+    bool edgeTriggered = argc > 1 && strcmp(argv[1], "et") == 0;
+    bool iouring = argc > 2 && strcmp(argv[2], "iouring") == 0;
+    const uint16_t port = freePort();
+    const int kPieces = 3000;
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(port), "etwrite");
+    server.setThreadNum(1);
+    server.setEdgeTriggered(edgeTriggered);
+    server.setPollerBackend(iouring ? EventLoop::kIoUringBackend : EventLoop::kEPollBackend);
+    TestSignal signal;
+    TCPConnectionPtr serverConn;
+    server.setConnectionCallback([&](const TCPConnectionPtr &conn) {
+        signal.update([&] { serverConn = conn->connected() ? conn : TCPConnectionPtr(); });
+    });
+    // 在消息回调中发送，注册channel时的第一个EPOLLOUT已经处理过了
+    server.setMessageCallback([kPieces](const TCPConnectionPtr &conn, Buffer *buf, Timestamp) {
+        buf->retrieveAll();
+        std::vector<std::string> pieces;
+        for (int i = 0; i < kPieces; ++i) {
+            pieces.push_back(std::to_string(i % 10));
+        }
+        conn->send(std::move(pieces));
+    });
+    startServer(server, baseLoop);
+
+    int fd = connectServer(port);
+    signal.wait([&serverConn] { return serverConn != nullptr; });
+    // 等注册之后的第一次poll处理完，之后不会再有EPOLLOUT
+    runInLoopAndWait(serverConn->getLoop(), [] {});
+    if (::write(fd, "go", 2) != 2) {
+        perror("write");
+    }
+    std::string received;
+    char buf[4096];
+    while (received.size() < static_cast<size_t>(kPieces)) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (::poll(&pfd, 1, 1000) <= 0) {
+            break;
+        }
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n <= 0) {
+            break;
+        }
+        received.append(buf, n);
+    }
+
+    bool ok = received.size() == static_cast<size_t>(kPieces);
+    for (size_t i = 0; ok && i < received.size(); ++i) {
+        ok = received[i] == static_cast<char>('0' + i % 10);
+    }
+    printf("%s %s received %zu of %d bytes: %s\n", edgeTriggered ? "et" : "lt", iouring ? "iouring" : "epoll",
+           received.size(), kPieces, ok ? "ok" : "FAILED");
+    ::close(fd);
+    signal.wait([&serverConn] { return !serverConn; });
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+#include "test_util.h"
+
+// 回显服务器启用自动流量控制，客户端只写不读，检查服务端积压的发送数据有上限，之后读回全部数据检查内容
+// 再检查stopRead期间收不到数据，startRead之后收到
+// 最后检查不启用流量控制时发送队列越过服务器设置的高水位，回调只调用一次，参数是这个连接和当时的积压字节数
+// 用法: flowcontrol_test [lt|et]
+
+// 客户端发送一个请求之后先不读，服务端分块发送kTotal字节，发送队列一定会越过高水位
+bool testHighWaterMark(EventLoop *baseLoop, bool edgeTriggered) {
+    const uint16_t port = freePort();
+    const size_t kMark = 1024 * 1024;
+    const size_t kChunk = 64 * 1024;
+    const size_t kTotal = 16 * 1024 * 1024;
+
+    TCPServer server(baseLoop, InetAddress(port), "highwater");
+    server.setThreadNum(1);
+    server.setEdgeTriggered(edgeTriggered);
+    TestSignal signal;
+    TCPConnectionPtr serverConn;
+    std::vector<std::pair<TCPConnectionPtr, size_t>> calls;
+    server.setHighWaterMarkCallback(
+        [&](const TCPConnectionPtr &conn, size_t len) { signal.update([&] { calls.emplace_back(conn, len); }); },
+        kMark);
+    server.setConnectionCallback([&](const TCPConnectionPtr &conn) {
+        signal.update([&] { serverConn = conn->connected() ? conn : TCPConnectionPtr(); });
+    });
+    server.setMessageCallback([kChunk, kTotal](const TCPConnectionPtr &conn, Buffer *buf, Timestamp) {
+        buf->retrieveAll();
+        std::string chunk(kChunk, '\0');
+        for (size_t sent = 0; sent < kTotal; sent += kChunk) {
+            for (size_t i = 0; i < kChunk; ++i) {
+                chunk[i] = static_cast<char>((sent + i) % 251);
+            }
+            conn->send(chunk);
+        }
+    });
+    startServer(server, baseLoop);
+
+    int fd = connectServer(port);
+    if (::write(fd, "go", 2) != 2) {
+        perror("write");
+    }
+    // 客户端还没开始读，回调一定会发生
+    signal.wait([&calls] { return !calls.empty(); });
+
+    std::vector<char> buf(64 * 1024);
+    size_t got = 0;
+    bool intact = true;
+    while (got < kTotal) {
+        ssize_t n = ::read(fd, buf.data(), buf.size());
+        if (n <= 0) {
+            break;
+        }
+        for (ssize_t i = 0; i < n; ++i) {
+            if (buf[i] != static_cast<char>((got + i) % 251)) {
+                intact = false;
+            }
+        }
+        got += n;
+    }
+
+    bool ok;
+    {
+        // 全部数据都收到了，之后不会再有回调，ioLoop中排队的回调也都执行完
+        TCPConnectionPtr conn;
+        signal.update([&] { conn = serverConn; });
+        if (conn) {
+            runInLoopAndWait(conn->getLoop(), [] {});
+        }
+        signal.update([&] {
+            // 越过高水位的那一次send之前积压不到kMark，这次最多追加kChunk字节
+            ok = got == kTotal && intact && calls.size() == 1 && serverConn && calls[0].first == serverConn &&
+                 calls[0].second >= kMark && calls[0].second < kMark + kChunk;
+            printf("high water mark %zu: received %zu of %zu bytes, intact: %s, callbacks %zu, queued %zu, same conn: %s\n",
+                   kMark, got, kTotal, intact ? "yes" : "no", calls.size(), calls.empty() ? 0 : calls[0].second,
+                   !calls.empty() && calls[0].first == serverConn ? "yes" : "no");
+            calls.clear();
+        });
+    }
+    ::close(fd);
+    signal.wait([&serverConn] { return !serverConn; });
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    bool edgeTriggered = argc > 1 && strcmp(argv[1], "et") == 0;
+    const uint16_t port = freePort();
+    const size_t kHighMark = 256 * 1024;
+    const size_t kLowMark = 64 * 1024;
+    const size_t kTotal = 32 * 1024 * 1024;
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(port), "flow");
+    server.setThreadNum(1);
+    server.setEdgeTriggered(edgeTriggered);
+    server.setFlowControl(kHighMark, kLowMark);
+    EventLoop *ioLoop = nullptr;
+    server.setThreadInitCallback([&ioLoop](EventLoop *loop) { ioLoop = loop; });
+    std::atomic<int> highWaterMarks(0);
+    server.setHighWaterMarkCallback([&highWaterMarks](const TCPConnectionPtr &, size_t) { ++highWaterMarks; },
+                                    4 * 1024 * 1024);
+    TestSignal signal;
+    TCPConnectionPtr serverConn;
+    std::atomic<long> received(0);
+    server.setConnectionCallback([&](const TCPConnectionPtr &conn) {
+        signal.update([&] { serverConn = conn->connected() ? conn : TCPConnectionPtr(); });
+    });
+    server.setMessageCallback([&](const TCPConnectionPtr &conn, Buffer *buf, Timestamp) {
+        received += buf->readableBytes();
+        conn->send(buf);
+        signal.notify();
+    });
+    startServer(server, baseLoop);
+
+    bool ok = true;
+    int fd = connectServer(port);
+    std::thread writer([fd, kTotal] {
+        std::vector<char> chunk(64 * 1024);
+        size_t sent = 0;
+        while (sent < kTotal) {
+            size_t len = std::min(chunk.size(), kTotal - sent);
+            for (size_t i = 0; i < len; ++i) {
+                chunk[i] = static_cast<char>((sent + i) % 251);
+            }
+            ssize_t n = ::write(fd, chunk.data(), len);
+            if (n <= 0) {
+                return;
+            }
+            sent += n;
+        }
+    });
+
+    // 客户端先不读，服务端的发送队列最多超过高水位一次读取的数据量
+    int64_t maxPending = 0;
+    for (int i = 0; i < 100; ++i) {
+        maxPending = std::max(maxPending, ioLoop->pendingBytes());
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    const int64_t kBound = kHighMark + 2 * 1024 * 1024;
+    printf("max pending while client not reading: %ld (bound %ld)\n", static_cast<long>(maxPending),
+           static_cast<long>(kBound));
+    if (maxPending == 0 || maxPending > kBound) {
+        ok = false;
+    }
+
+    std::vector<char> buf(64 * 1024);
+    size_t got = 0;
+    bool intact = true;
+    while (got < kTotal) {
+        ssize_t n = ::read(fd, buf.data(), buf.size());
+        if (n <= 0) {
+            break;
+        }
+        for (ssize_t i = 0; i < n; ++i) {
+            if (buf[i] != static_cast<char>((got + i) % 251)) {
+                intact = false;
+            }
+        }
+        got += n;
+        maxPending = std::max(maxPending, ioLoop->pendingBytes());
+    }
+    writer.join();
+    printf("echoed %zu of %zu bytes, intact: %s, max pending %ld, high water callbacks %d\n", got, kTotal,
+           intact ? "yes" : "no", static_cast<long>(maxPending), highWaterMarks.load());
+    if (got != kTotal || !intact || maxPending > kBound || highWaterMarks != 0) {
+        ok = false;
+    }
+
+    // 手动停止读取，在ioLoop中同步一次之后已经不再读socket
+    TCPConnectionPtr conn;
+    signal.update([&] { conn = serverConn; });
+    conn->stopRead();
+    runInLoopAndWait(ioLoop, [] {});
+    long before = received;
+    const char message[] = "paused";
+    if (::write(fd, message, sizeof(message)) != static_cast<ssize_t>(sizeof(message))) {
+        ok = false;
+    }
+    // 停止读取期间给数据一段到达服务端的时间，之后确认没有被读取
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    long whilePaused = received - before;
+    conn->startRead();
+    signal.wait([&] { return received - before >= static_cast<long>(sizeof(message)); });
+    long afterResume = received - before;
+    printf("stopRead: received %ld while paused, %ld after startRead\n", whilePaused, afterResume);
+    if (whilePaused != 0 || afterResume != static_cast<long>(sizeof(message))) {
+        ok = false;
+    }
+    // 读掉回显的数据，否则关闭时对端会收到RST
+    char echoed[sizeof(message)];
+    ::read(fd, echoed, sizeof(echoed));
+
+    ::close(fd);
+    conn.reset();
+    signal.wait([&serverConn] { return !serverConn; });
+
+    if (!testHighWaterMark(baseLoop, edgeTriggered)) {
+        ok = false;
+    }
+    printf("%s %s\n", edgeTriggered ? "et" : "lt", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+#include "test_util.h"
+
+// io loop忙的时候客户端发送数据之后马上关闭写端(FIN)或者重置连接(RST)，数据和FIN/RST在同一次事件中到达
+// 检查服务端收到了全部数据，并且每个连接都被关闭
+// 用法: halfclose_test [lt|et] [epoll|iouring]
+int main(int argc, char *argv[]) {
+    bool edgeTriggered = argc > 1 && strcmp(argv[1], "et") == 0;
+    bool iouring = argc > 2 && strcmp(argv[2], "iouring") == 0;
+    const uint16_t port = freePort();
+    const int kConns = 20;
+    const char kMessage[] = "hello";
+    Logger::setLogLevel(FATAL);
+
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(port), "halfclose");
+    server.setThreadNum(1);
+    server.setEdgeTriggered(edgeTriggered);
+    server.setPollerBackend(iouring ? EventLoop::kIoUringBackend : EventLoop::kEPollBackend);
+    EventLoop *ioLoop = nullptr;
+    server.setThreadInitCallback([&ioLoop](EventLoop *loop) { ioLoop = loop; });
+    std::atomic<int> established(0);
+    std::atomic<int> closed(0);
+    std::atomic<long> received(0);
+    TestSignal signal;
+    server.setConnectionCallback([&](const TCPConnectionPtr &conn) {
+        if (conn->connected()) {
+            ++established;
+        } else {
+            ++closed;
+        }
+        signal.notify();
+    });
+    server.setMessageCallback([&received](const TCPConnectionPtr &, Buffer *buf, Timestamp) {
+        received += buf->readableBytes();
+        buf->retrieveAll();
+    });
+    startServer(server, baseLoop);
+
+    bool ok = true;
+    const char *cases[] = {"fin", "rst"};
+    for (const char *mode : cases) {
+        bool reset = strcmp(mode, "rst") == 0;
+        established = 0;
+        closed = 0;
+        received = 0;
+        std::vector<int> fds;
+        for (int i = 0; i < kConns; ++i) {
+            fds.push_back(connectServer(port));
+        }
+        signal.wait([&] { return established == kConns; });
+
+        // 让io loop忙一会，数据和FIN/RST都到达之后才处理
+        std::atomic_bool stalled(false);
+        ioLoop->runInLoop([&] {
+            stalled = true;
+            signal.notify();
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        });
+        signal.wait([&stalled] { return stalled.load(); });
+        for (int fd : fds) {
+            if (::write(fd, kMessage, sizeof(kMessage)) != static_cast<ssize_t>(sizeof(kMessage))) {
+                ok = false;
+            }
+            if (reset) {
+                struct linger lg = {1, 0};
+                ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+                ::close(fd);
+            } else {
+                ::shutdown(fd, SHUT_WR);
+            }
+        }
+
+        signal.wait([&] { return closed == kConns; }, 1000);
+        // RST会丢弃还没读的数据，只检查FIN的情况
+        bool pass = closed == kConns && (reset || received == kConns * static_cast<long>(sizeof(kMessage)));
+        printf("%s %s %s: closed %d of %d, received %ld bytes: %s\n", edgeTriggered ? "et" : "lt",
+               iouring ? "iouring" : "epoll", mode, closed.load(), kConns, received.load(), pass ? "ok" : "FAILED");
+        ok = ok && pass;
+        if (!reset) {
+            for (int fd : fds) {
+                ::close(fd);
+            }
+        }
+    }
+    return ok ? 0 : 1;
+}
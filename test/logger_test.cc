@@ -8,6 +8,7 @@
 
 int main() {
     std::string author = "Ephmeral";
+    Logger::setLogLevel(DEBUG);
     LOG_DEBUG("this is a log debug mesasage, wirte by %s", author.c_str());
     LOG_INFO("this is a log info message");
     LOG_ERROR("this is a log error message");
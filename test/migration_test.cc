@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+#include "test_util.h"
+
+// 连接在多个loop之间不停迁移，同时有回显和其他线程的发送，检查数据没有丢失和乱序
+// 用法: migration_test [lt|et] [seconds]
+TestSignal g_signal;
+// 以下状态通过g_signal.update修改
+std::vector<TCPConnectionPtr> g_conns;
+int g_closed = 0;
+
+bool readFull(int fd, char *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = ::read(fd, buf + got, len - got);
+        if (n <= 0) {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    bool edgeTriggered = argc > 1 && strcmp(argv[1], "et") == 0;
+    int seconds = argc > 2 ? atoi(argv[2]) : 2;
+    const uint16_t port = freePort();
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(port), "migrate");
+    server.setThreadNum(3);
+    server.setEdgeTriggered(edgeTriggered);
+    std::vector<EventLoop *> loops;
+    server.setThreadInitCallback([&loops](EventLoop *loop) { loops.push_back(loop); });
+    server.setConnectionCallback([](const TCPConnectionPtr &conn) {
+        g_signal.update([&conn] {
+            if (conn->connected()) {
+                g_conns.push_back(conn);
+            } else {
+                ++g_closed;
+            }
+        });
+    });
+    // 第一个字节为'E'的连接回显，'P'的连接由其他线程推送数据
+    server.setMessageCallback([](const TCPConnectionPtr &conn, Buffer *buf, Timestamp) {
+        if (buf->peek()[0] == 'P') {
+            buf->retrieveAll();
+        } else {
+            conn->send(buf);
+        }
+    });
+    startServer(server, baseLoop);
+
+    int echoFd = connectServer(port);
+    int pushFd = connectServer(port);
+    ::write(pushFd, "P", 1);
+    g_signal.wait([] { return g_conns.size() == 2; });
+    // 两个连接的回调可能在不同的loop中，按照客户端的端口找到推送的连接
+    TCPConnectionPtr pushConn = g_conns[0];
+    if (pushConn->peerAddress().toPort() != localPort(pushFd)) {
+        pushConn = g_conns[1];
+    }
+
+    std::atomic_bool running(true);
+    std::atomic<long> echoed(0), pushed(0);
+    std::atomic_bool ok(true);
+
+    // 回显: 写入带序号的数据，读回来逐字节比较
+    std::thread echoClient([&] {
+        std::string out(16 * 1024, '\0');
+        std::string in(out.size(), '\0');
+        unsigned char seq = 0;
+        out[0] = 'E';
+        while (running && ok) {
+            for (size_t i = 1; i < out.size(); ++i) {
+                out[i] = static_cast<char>(seq++);
+            }
+            std::thread writer([&] { ::write(echoFd, out.data(), out.size()); });
+            if (!readFull(echoFd, &in[0], in.size()) || in != out) {
+                printf("echo mismatch after %ld bytes\n", echoed.load());
+                ok = false;
+            }
+            writer.join();
+            echoed += in.size();
+        }
+    });
+
+    // 推送: 其他线程按顺序发送递增的序号
+    std::thread pusher([&] {
+        uint32_t next = 0;
+        while (running) {
+            std::string msg;
+            for (int i = 0; i < 64; ++i, ++next) {
+                msg.append(reinterpret_cast<const char *>(&next), sizeof next);
+            }
+            pushConn->send(std::move(msg));
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        pushConn->send(std::string("\xff\xff\xff\xff", 4));
+    });
+    std::thread pushClient([&] {
+        uint32_t expected = 0, value = 0;
+        while (readFull(pushFd, reinterpret_cast<char *>(&value), sizeof value) && value != 0xffffffff) {
+            if (value != expected) {
+                printf("push out of order: expected %u got %u\n", expected, value);
+                ok = false;
+                break;
+            }
+            ++expected;
+            pushed += sizeof value;
+        }
+    });
+
+    // 不停地把两个连接迁移到下一个loop
+    // 上一次迁移还没完成时migrate会被忽略，按getLoop()实际变化的次数统计完成的迁移
+    int requests = 0;
+    int moves = 0;
+    std::vector<EventLoop *> lastLoops;
+    for (const TCPConnectionPtr &conn : g_conns) {
+        lastLoops.push_back(conn->getLoop());
+    }
+    auto countMoves = [&] {
+        for (size_t c = 0; c < g_conns.size(); ++c) {
+            EventLoop *loop = g_conns[c]->getLoop();
+            if (loop != lastLoops[c]) {
+                ++moves;
+                lastLoops[c] = loop;
+            }
+        }
+    };
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < deadline && ok) {
+        countMoves();
+        for (const TCPConnectionPtr &conn : g_conns) {
+            EventLoop *loop = conn->getLoop();
+            size_t i = std::find(loops.begin(), loops.end(), loop) - loops.begin();
+            conn->migrate(loops[(i + 1) % loops.size()]);
+            ++requests;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    running = false;
+    pusher.join();
+    pushClient.join();
+    echoClient.join();
+    countMoves();
+
+    // 迁移确实发生过，并且迁移期间两个方向都有数据
+    if (moves == 0 || echoed == 0 || pushed == 0) {
+        ok = false;
+    }
+    printf("%s migrations requested=%d completed=%d echoed=%ld pushed=%ld: %s\n", edgeTriggered ? "et" : "lt",
+           requests, moves, echoed.load(), pushed.load(), ok ? "ok" : "FAILED");
+    ::close(echoFd);
+    ::close(pushFd);
+    g_signal.wait([] { return g_closed == 2; });
+    g_conns.clear();
+    return ok ? 0 : 1;
+}
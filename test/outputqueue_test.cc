@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include "../OutputQueue.h"
+
+int main() {
+    int fds[2];
+    if (::pipe(fds) < 0) {
+        perror("pipe");
+        return 1;
+    }
+
+    OutputQueue queue;
+    // 小块的拷贝数据合并成一个数据段
+    queue.append("GET / ", 6);
+    queue.append("HTTP/1.1\r\n", 10);
+    queue.append(std::string("Host: localhost\r\n\r\n"));
+    std::shared_ptr<const std::string> shared = std::make_shared<std::string>("shared-body|");
+    queue.append(shared, shared->data(), shared->size());
+    Buffer buf;
+    buf.append("buffer-chunk", 12);
+    queue.append(std::move(buf));
+    printf("bytes: %lu segments: %lu\n", queue.readableBytes(), queue.numSegments());
+
+    // 丢弃头部的一部分数据，剩余的数据从数据段中间开始发送
+    queue.retrieve(4);
+    printf("after retrieve(4) bytes: %lu segments: %lu\n", queue.readableBytes(), queue.numSegments());
+    int saveErrno = 0;
+    ssize_t n = queue.writeFd(fds[1], &saveErrno);
+    queue.retrieve(n);
+    printf("writev: %ld, empty: %d\n", n, queue.empty());
+
+    char out[256];
+    ssize_t len = ::read(fds[0], out, sizeof out);
+    printf("%.*s\n", static_cast<int>(len), out);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return 0;
+}
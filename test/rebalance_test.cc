@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+#include "test_util.h"
+
+// 两个subloop，轮询分配四个回显连接，让同一个loop上的两个连接持续收发数据，其他连接空闲
+// 检查rebalance把其中一个忙的连接迁移到另一个loop，之后负载均衡了不再来回迁移，空闲的连接不动
+// 用法: rebalance_test [lt|et]
+TestSignal g_signal;
+// 以下状态通过g_signal.update修改
+std::map<uint16_t, TCPConnectionPtr> g_conns;  // 客户端端口 -> 连接
+int g_closed = 0;
+
+bool readFull(int fd, char *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = ::read(fd, buf + got, len - got);
+        if (n <= 0) {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    bool edgeTriggered = argc > 1 && strcmp(argv[1], "et") == 0;
+    const uint16_t port = freePort();
+    const int kConns = 4;
+    const double kInterval = 0.2;
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(port), "rebalance");
+    server.setThreadNum(2);
+    server.setEdgeTriggered(edgeTriggered);
+    server.setRebalanceInterval(kInterval);
+    server.setConnectionCallback([](const TCPConnectionPtr &conn) {
+        g_signal.update([&conn] {
+            if (conn->connected()) {
+                g_conns[conn->peerAddress().toPort()] = conn;
+            } else {
+                ++g_closed;
+            }
+        });
+    });
+    server.setMessageCallback([](const TCPConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+        g_signal.notify();
+    });
+    startServer(server, baseLoop);
+
+    std::vector<int> fds;
+    for (int i = 0; i < kConns; ++i) {
+        fds.push_back(connectServer(port));
+    }
+    g_signal.wait([] { return g_conns.size() == kConns; });
+
+    // 找到同一个loop上的两个连接作为忙连接
+    std::map<EventLoop *, std::vector<int>> byLoop;
+    for (int fd : fds) {
+        byLoop[g_conns[localPort(fd)]->getLoop()].push_back(fd);
+    }
+    EventLoop *busyLoop = nullptr;
+    for (auto &item : byLoop) {
+        if (item.second.size() >= 2) {
+            busyLoop = item.first;
+        }
+    }
+    std::vector<int> busyFds(byLoop[busyLoop].begin(), byLoop[busyLoop].begin() + 2);
+    std::vector<TCPConnectionPtr> busyConns, idleConns;
+    for (int fd : fds) {
+        bool busy = std::find(busyFds.begin(), busyFds.end(), fd) != busyFds.end();
+        (busy ? busyConns : idleConns).push_back(g_conns[localPort(fd)]);
+    }
+    std::vector<EventLoop *> idleLoops;
+    for (const TCPConnectionPtr &conn : idleConns) {
+        idleLoops.push_back(conn->getLoop());
+    }
+
+    std::atomic_bool running(true);
+    std::atomic_bool intact(true);
+    std::vector<std::thread> clients;
+    for (int fd : busyFds) {
+        clients.emplace_back([fd, &running, &intact] {
+            std::string out(16 * 1024, 'x');
+            std::string in(out.size(), '\0');
+            while (running) {
+                if (::write(fd, out.data(), out.size()) != static_cast<ssize_t>(out.size()) ||
+                    !readFull(fd, &in[0], in.size()) || in != out) {
+                    intact = false;
+                    return;
+                }
+            }
+        });
+    }
+
+    // 忙连接的回显回调不断唤醒，直到有一个忙连接离开了原来的loop
+    auto busyLoopsNow = [&busyConns] {
+        std::vector<EventLoop *> loops;
+        for (const TCPConnectionPtr &conn : busyConns) {
+            loops.push_back(conn->getLoop());
+        }
+        return loops;
+    };
+    bool moved = g_signal.wait([&] {
+        std::vector<EventLoop *> loops = busyLoopsNow();
+        return loops[0] != busyLoop || loops[1] != busyLoop;
+    }, 10000);
+
+    // 再经过几轮rebalance，两个忙连接各在一个loop上，负载已经均衡，不应该再迁移
+    std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(kInterval * 1000 * 4)));
+    std::vector<EventLoop *> busyLoops = busyLoopsNow();
+    bool balanced = busyLoops[0] != busyLoops[1];
+    bool idleStayed = true;
+    for (size_t i = 0; i < idleConns.size(); ++i) {
+        idleStayed = idleStayed && idleConns[i]->getLoop() == idleLoops[i];
+    }
+    running = false;
+    for (std::thread &client : clients) {
+        client.join();
+    }
+
+    bool ok = moved && balanced && idleStayed && intact;
+    printf("%s moved from busiest loop: %s, balanced: %s, idle stayed: %s, echo intact: %s: %s\n",
+           edgeTriggered ? "et" : "lt", moved ? "yes" : "no", balanced ? "yes" : "no", idleStayed ? "yes" : "no",
+           intact ? "yes" : "no", ok ? "ok" : "FAILED");
+
+    busyConns.clear();
+    idleConns.clear();
+    for (int fd : fds) {
+        ::close(fd);
+    }
+    g_signal.wait([] { return g_closed == kConns; });
+    g_signal.update([] { g_conns.clear(); });
+    return ok ? 0 : 1;
+}
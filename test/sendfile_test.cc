@@ -0,0 +1,145 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+#include "test_util.h"
+
+// 客户端发送"full"或者"trunc"，服务端先发送一段header，再sendFile临时文件的一个区间，最后再发送一段trailer
+// sendFile之后马上关闭并删除文件，检查dup出来的fd让数据照常发送，连接关闭之后fd也被关闭了
+// "full"检查收到的数据完整，"trunc"声明的长度超过文件长度，检查发完文件剩余的数据之后连接被强制关闭
+// 用法: sendfile_test [lt|et] [epoll|iouring]
+const char kHeader[] = "HEADER";
+const char kTrailer[] = "TRAILER";
+const size_t kFileSize = 1024 * 1024;
+const off_t kOffset = 1000;
+const size_t kLength = 600 * 1000;
+const size_t kTruncatedSize = 64 * 1024;
+
+int countOpenFds() {
+    int count = 0;
+    DIR *dir = ::opendir("/proc/self/fd");
+    while (::readdir(dir) != nullptr) {
+        ++count;
+    }
+    ::closedir(dir);
+    return count;
+}
+
+char fileByte(size_t pos) {
+    return static_cast<char>(pos % 251);
+}
+
+// 创建一个size字节的临时文件并删除它的路径，返回打开的fd
+int createTempFile(size_t size) {
+    char path[] = "/tmp/sendfile_test.XXXXXX";
+    int fd = ::mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        exit(1);
+    }
+    ::unlink(path);
+    std::string content(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        content[i] = fileByte(i);
+    }
+    if (::write(fd, content.data(), size) != static_cast<ssize_t>(size)) {
+        perror("write");
+        exit(1);
+    }
+    return fd;
+}
+
+// 读到对端关闭连接为止
+std::string readAll(int fd) {
+    std::string received;
+    char buf[64 * 1024];
+    for (;;) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n <= 0) {
+            break;
+        }
+        received.append(buf, n);
+    }
+    return received;
+}
+
+int main(int argc, char *argv[]) {
+    bool edgeTriggered = argc > 1 && strcmp(argv[1], "et") == 0;
+    bool iouring = argc > 2 && strcmp(argv[2], "iouring") == 0;
+    const uint16_t port = freePort();
+    Logger::setLogLevel(FATAL);
+
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(port), "sendfile");
+    server.setThreadNum(1);
+    server.setEdgeTriggered(edgeTriggered);
+    server.setPollerBackend(iouring ? EventLoop::kIoUringBackend : EventLoop::kEPollBackend);
+    EventLoop *ioLoop = nullptr;
+    server.setThreadInitCallback([&ioLoop](EventLoop *loop) { ioLoop = loop; });
+    std::atomic<int> closed(0);
+    TestSignal signal;
+    server.setConnectionCallback([&](const TCPConnectionPtr &conn) {
+        if (!conn->connected()) {
+            ++closed;
+            signal.notify();
+        }
+    });
+    server.setMessageCallback([](const TCPConnectionPtr &conn, Buffer *buf, Timestamp) {
+        bool truncated = buf->retrieveAllAsString() == "trunc";
+        conn->send(std::string(kHeader));
+        int fd = createTempFile(truncated ? kTruncatedSize : kFileSize);
+        conn->sendFile(fd, truncated ? 0 : kOffset, kLength);
+        ::close(fd);
+        conn->send(std::string(kTrailer));
+        if (!truncated) {
+            conn->shutdown();
+        }
+    });
+    startServer(server, baseLoop);
+    int baseFds = countOpenFds();
+
+    bool ok = true;
+    const char *cases[] = {"full", "trunc"};
+    for (const char *mode : cases) {
+        bool truncated = strcmp(mode, "trunc") == 0;
+        closed = 0;
+        int fd = connectServer(port);
+        if (::write(fd, mode, strlen(mode)) != static_cast<ssize_t>(strlen(mode))) {
+            perror("write");
+        }
+        std::string received = readAll(fd);
+        ::close(fd);
+        signal.wait([&closed] { return closed == 1; }, 1000);
+        // 关闭回调返回之后connectDestoryed才排进ioLoop，第一次同步之后它已经在队列中，第二次同步时已经执行完
+        // 连接对象和它的fd都释放了
+        runInLoopAndWait(ioLoop, [] {});
+        runInLoopAndWait(ioLoop, [] {});
+
+        // 截断的情况下只收到header和文件剩下的数据，trailer被丢弃
+        size_t fileBegin = truncated ? 0 : kOffset;
+        size_t fileLen = truncated ? kTruncatedSize : kLength;
+        std::string expected(kHeader);
+        for (size_t i = 0; i < fileLen; ++i) {
+            expected.push_back(fileByte(fileBegin + i));
+        }
+        if (!truncated) {
+            expected.append(kTrailer);
+        }
+        int leakedFds = countOpenFds() - baseFds;
+        bool pass = received == expected && closed == 1 && leakedFds == 0;
+        printf("%s %s %s: received %zu of %zu bytes, closed %d, leaked fds %d: %s\n", edgeTriggered ? "et" : "lt",
+               iouring ? "iouring" : "epoll", mode, received.size(), expected.size(), closed.load(), leakedFds,
+               pass ? "ok" : "FAILED");
+        ok = ok && pass;
+    }
+    return ok ? 0 : 1;
+}
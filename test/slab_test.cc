@@ -0,0 +1,69 @@
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Slab.h"
+
+namespace {
+
+struct Object {
+    explicit Object(int v) : value(v), name("object-" + std::to_string(v)) {}
+    int value;
+    std::string name;
+};
+
+}  // namespace
+
+int main() {
+    SlabPtr slab = std::make_shared<Slab>(4);
+
+    // 对象和控制块一起从slab中分配
+    std::vector<std::shared_ptr<Object>> objects;
+    for (int i = 0; i < 10; ++i) {
+        objects.push_back(std::allocate_shared<Object>(SlabAllocator<Object>(slab), i));
+    }
+    printf("allocated: %lu blocks: %lu slot size >= object: %d\n", slab->numAllocated(), slab->numBlocks(),
+           slab->objectSize() >= sizeof(Object));
+    printf("first: %s last: %s\n", objects.front()->name.c_str(), objects.back()->name.c_str());
+
+    // 在其他线程中释放最后一个引用
+    std::thread other([&objects] { objects.resize(5); });
+    other.join();
+    printf("after release in other thread allocated: %lu\n", slab->numAllocated());
+
+    // 释放的槽位被重新使用，不需要新的块
+    for (int i = 0; i < 5; ++i) {
+        objects.push_back(std::allocate_shared<Object>(SlabAllocator<Object>(slab), 100 + i));
+    }
+    printf("reuse allocated: %lu blocks: %lu\n", slab->numAllocated(), slab->numBlocks());
+
+    // 大小不同的请求不经过slab
+    void *other1 = slab->allocate(slab->objectSize() * 2);
+    slab->deallocate(other1, slab->objectSize() * 2);
+    printf("other size allocated: %lu\n", slab->numAllocated());
+
+    // 连接数回落之后，全部空闲的块还给malloc，只保留一个
+    std::vector<std::shared_ptr<Object>> burst;
+    for (int i = 0; i < 20; ++i) {
+        burst.push_back(std::allocate_shared<Object>(SlabAllocator<Object>(slab), 200 + i));
+    }
+    size_t peakBlocks = slab->numBlocks();
+    burst.clear();
+    printf("after burst allocated: %lu blocks: %lu (peak %lu)\n", slab->numAllocated(), slab->numBlocks(),
+           peakBlocks);
+    // 再次增长时先用保留的空闲块
+    burst.push_back(std::allocate_shared<Object>(SlabAllocator<Object>(slab), 300));
+    printf("regrow blocks: %lu\n", slab->numBlocks());
+    burst.clear();
+
+    // slab由分配出去的对象共同持有，比最后一个对象活得更久
+    std::weak_ptr<Slab> weak = slab;
+    slab.reset();
+    printf("slab alive while objects exist: %d\n", !weak.expired());
+    objects.clear();
+    printf("slab released with last object: %d\n", weak.expired());
+    return 0;
+}
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../EventLoopThread.h"
+#include "../Logger.h"
+#include "../TCPServer.h"
+#include "test_util.h"
+
+// 连接建立之后流式发送一个大的响应，客户端读得比较慢
+// 检查服务端发送队列中最多只有一块数据，客户端收到的数据完整，全部发完之后调用一次writeComplete
+// 再检查producer暂时没有数据时流暂停，不会反复拉取，resumeStream之后继续，暂停期间shutdown等流结束才关闭写端
+// 用法: stream_test [lt|et] [MB]
+
+// producer的数据由测试线程分几次提供，每次提供之前流都处于暂停状态
+bool testPausedStream(EventLoop *baseLoop, bool edgeTriggered) {
+    const uint16_t port = freePort();
+    const int kRounds = 4;
+    const size_t kChunk = 1000;
+
+    TCPServer server(baseLoop, InetAddress(port), "paused");
+    server.setThreadNum(1);
+    server.setEdgeTriggered(edgeTriggered);
+    EventLoop *ioLoop = nullptr;
+    server.setThreadInitCallback([&ioLoop](EventLoop *loop) { ioLoop = loop; });
+    TestSignal signal;
+    // 以下状态通过signal.update修改
+    TCPConnectionPtr serverConn;
+    std::string available;
+    bool finished = false;
+    int emptyPulls = 0;
+    int writeCompletes = 0;
+    server.setConnectionCallback([&](const TCPConnectionPtr &conn) {
+        signal.update([&] { serverConn = conn->connected() ? conn : TCPConnectionPtr(); });
+        if (conn->connected()) {
+            conn->sendStream([&](const TCPConnectionPtr &, Buffer *buf) {
+                bool more = true;
+                signal.update([&] {
+                    if (available.empty()) {
+                        ++emptyPulls;
+                    }
+                    buf->append(available.data(), available.size());
+                    available.clear();
+                    more = !finished;
+                });
+                return more;
+            });
+        }
+    });
+    server.setWriteCompleteCallback([&](const TCPConnectionPtr &) { signal.update([&] { ++writeCompletes; }); });
+    startServer(server, baseLoop);
+
+    int fd = connectServer(port);
+    TCPConnectionPtr conn;
+    signal.wait([&serverConn] { return serverConn != nullptr; });
+    signal.update([&] { conn = serverConn; });
+
+    bool ok = true;
+    bool intact = true;
+    int maxEmptyPulls = 0;
+    std::vector<char> buf(kChunk);
+    for (int round = 0; round < kRounds; ++round) {
+        // 每次同步都会经过一轮poll和队列中的回调，如果流没有暂停，producer会被反复调用
+        for (int i = 0; i < 3; ++i) {
+            runInLoopAndWait(ioLoop, [] {});
+        }
+        signal.update([&] {
+            // 每次暂停只拉到一次空数据
+            maxEmptyPulls = std::max(maxEmptyPulls, emptyPulls);
+            ok = ok && emptyPulls == 1 && writeCompletes == 0;
+            emptyPulls = 0;
+            available.assign(kChunk, static_cast<char>('a' + round));
+            finished = round == kRounds - 1;
+        });
+        if (round == kRounds - 1) {
+            conn->shutdown();
+        }
+        conn->resumeStream();
+        size_t got = 0;
+        while (got < kChunk) {
+            ssize_t n = ::read(fd, buf.data() + got, kChunk - got);
+            if (n <= 0) {
+                break;
+            }
+            got += n;
+        }
+        intact = intact && got == kChunk && std::count(buf.begin(), buf.end(), 'a' + round) == static_cast<long>(kChunk);
+    }
+    // 流结束之后才关闭写端
+    bool eof = ::read(fd, buf.data(), buf.size()) == 0;
+    signal.wait([&writeCompletes] { return writeCompletes > 0; }, 1000);
+    runInLoopAndWait(ioLoop, [] {});
+    signal.update([&] { ok = ok && intact && eof && writeCompletes == 1 && emptyPulls == 0; });
+    printf("paused stream: %d rounds, max empty pulls per pause %d, intact: %s, eof after stream: %s, "
+           "write completes %d\n",
+           kRounds, maxEmptyPulls, intact ? "yes" : "no", eof ? "yes" : "no", writeCompletes);
+
+    conn.reset();
+    ::close(fd);
+    signal.wait([&serverConn] { return !serverConn; });
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    bool edgeTriggered = argc > 1 && strcmp(argv[1], "et") == 0;
+    const size_t total = static_cast<size_t>(argc > 2 ? atoi(argv[2]) : 256) * 1024 * 1024;
+    const uint16_t port = freePort();
+    const size_t kChunkSize = 64 * 1024;
+    Logger::setLogLevel(ERROR);
+
+    EventLoopThread baseThread;
+    EventLoop *baseLoop = baseThread.startLoop();
+    TCPServer server(baseLoop, InetAddress(port), "stream");
+    server.setThreadNum(1);
+    server.setEdgeTriggered(edgeTriggered);
+    EventLoop *ioLoop = nullptr;
+    server.setThreadInitCallback([&ioLoop](EventLoop *loop) { ioLoop = loop; });
+
+    std::atomic<long> produced(0);
+    std::atomic<int> producerCalls(0);
+    std::atomic<int> writeCompletes(0);
+    std::atomic_bool closed(false);
+    TestSignal signal;
+    server.setConnectionCallback([&](const TCPConnectionPtr &conn) {
+        if (!conn->connected()) {
+            closed = true;
+            signal.notify();
+            return;
+        }
+        conn->setTcpNotSentLowat(128 * 1024);
+        conn->sendStream([&, total, kChunkSize](const TCPConnectionPtr &, Buffer *buf) {
+            ++producerCalls;
+            size_t offset = produced;
+            size_t len = std::min(kChunkSize, total - offset);
+            std::string chunk(len, '\0');
+            for (size_t i = 0; i < len; ++i) {
+                chunk[i] = static_cast<char>((offset + i) % 251);
+            }
+            buf->append(chunk.data(), len);
+            produced += len;
+            return offset + len < total;
+        });
+    });
+    server.setWriteCompleteCallback([&](const TCPConnectionPtr &) {
+        ++writeCompletes;
+        signal.notify();
+    });
+    startServer(server, baseLoop);
+
+    int fd = connectServer(port);
+    std::vector<char> buf(16 * 1024);
+    size_t got = 0;
+    bool intact = true;
+    int64_t maxPending = 0;
+    int reads = 0;
+    while (got < total) {
+        ssize_t n = ::read(fd, buf.data(), buf.size());
+        if (n <= 0) {
+            break;
+        }
+        for (ssize_t i = 0; i < n; ++i) {
+            if (buf[i] != static_cast<char>((got + i) % 251)) {
+                intact = false;
+            }
+        }
+        got += n;
+        maxPending = std::max(maxPending, ioLoop->pendingBytes());
+        if (++reads % 256 == 0) {
+            // 时不时停一下，让服务端的socket写满
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    // 全部发送完之后writeComplete才排进ioLoop，等它执行，再同步一次确认没有多余的调用
+    signal.wait([&writeCompletes] { return writeCompletes > 0; }, 1000);
+    runInLoopAndWait(ioLoop, [] {});
+
+    bool ok = got == total && intact && maxPending <= static_cast<int64_t>(kChunkSize) && writeCompletes == 1 &&
+              produced == static_cast<long>(total);
+    printf("%s received %zu of %zu bytes, intact: %s, producer calls %d, max pending %ld, write completes %d: %s\n",
+           edgeTriggered ? "et" : "lt", got, total, intact ? "yes" : "no", producerCalls.load(),
+           static_cast<long>(maxPending), writeCompletes.load(), ok ? "ok" : "FAILED");
+    ::close(fd);
+    signal.wait([&closed] { return closed.load(); });
+
+    if (!testPausedStream(baseLoop, edgeTriggered)) {
+        ok = false;
+    }
+    printf("%s %s\n", edgeTriggered ? "et" : "lt", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
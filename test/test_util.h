@@ -0,0 +1,98 @@
+#pragma once
+
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+
+#include "../EventLoop.h"
+#include "../InetAddress.h"
+#include "../TCPServer.h"
+#include "../nocopyable.h"
+
+// 网络测试公用的辅助函数，只有头文件，每个测试各自包含
+
+// 由内核分配一个当前空闲的端口，测试之间不需要约定端口号，可以同时运行
+inline uint16_t freePort() {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(0);
+    if (::bind(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+        perror("bind");
+        exit(1);
+    }
+    sockaddr_in local;
+    socklen_t len = sizeof(local);
+    ::getsockname(fd, (sockaddr *)&local, &len);
+    ::close(fd);
+    return ntohs(local.sin_port);
+}
+
+// 连接本机的port，失败时退出进程
+inline int connectServer(uint16_t port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(port);
+    if (::connect(fd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    return fd;
+}
+
+// 客户端socket的本地端口，等于服务端连接的peerAddress().toPort()
+inline uint16_t localPort(int fd) {
+    sockaddr_in local;
+    socklen_t len = sizeof(local);
+    ::getsockname(fd, (sockaddr *)&local, &len);
+    return ntohs(local.sin_port);
+}
+
+// 在loop线程中执行cb，返回时已经执行完
+// loop在这之前收到的回调和下一次poll的事件都已经处理完了，可以当作loop的同步点
+inline void runInLoopAndWait(EventLoop *loop, const std::function<void()> &cb) {
+    std::promise<void> done;
+    loop->runInLoop([&cb, &done] {
+        cb();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+// 启动server，返回时baseLoop已经开始listen，客户端可以直接连接
+inline void startServer(TCPServer &server, EventLoop *baseLoop) {
+    server.start();
+    runInLoopAndWait(baseLoop, [] {});
+}
+
+// 回调线程和测试线程之间的同步，回调中通过update修改状态，测试线程等待条件成立
+// change和pred都在内部的锁中执行，它们访问的状态不需要再加锁
+class TestSignal : nocopyable {
+public:
+    template <typename Change>
+    void update(Change change) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        change();
+        cond_.notify_all();
+    }
+    // 状态是原子变量时，修改之后只需要唤醒
+    void notify() {
+        update([] {});
+    }
+
+    // 等待pred成立，超时返回false
+    template <typename Pred>
+    bool wait(Pred pred, int timeoutMs = 5000) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cond_.wait_for(lock, std::chrono::milliseconds(timeoutMs), pred);
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+};
@@ -0,0 +1,41 @@
+#include <stdio.h>
+
+#include <thread>
+
+#include "../EventLoop.h"
+
+int cnt = 0;
+EventLoop *g_loop = nullptr;
+
+void print(const char *msg) {
+    printf("%s %s\n", Timestamp::now().toString().c_str(), msg);
+}
+
+void printEvery() {
+    print("every 0.5");
+    if (++cnt == 5) {
+        g_loop->quit();
+    }
+}
+
+int main() {
+    EventLoop loop;
+    g_loop = &loop;
+
+    print("main");
+    loop.runAfter(0.3, std::bind(print, "once 0.3"));
+    loop.runAfter(0.1, std::bind(print, "once 0.1"));
+    TimerId toCancel = loop.runAfter(1.0, std::bind(print, "once 1.0, should be canceled"));
+    loop.runEvery(0.5, printEvery);
+    loop.cancel(toCancel);
+
+    // 在其他线程中添加定时器
+    std::thread t([&loop] {
+        loop.runAfter(0.2, std::bind(print, "once 0.2 from other thread"));
+    });
+    t.join();
+
+    loop.loop();
+    print("main loop exits");
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include <stdio.h>
+
+#include "../EventLoop.h"
+#include "../TimingWheel.h"
+
+int main() {
+    EventLoop loop;
+    TimingWheel wheel(&loop, 0.1, 8);
+
+    // 超时时间超过一圈的条目也能正确触发
+    TimingWheel::Entry e1([&wheel] { printf("e1 expired at tick %lu\n", wheel.now()); });
+    TimingWheel::Entry e2([&wheel] { printf("e2 expired at tick %lu\n", wheel.now()); });
+    TimingWheel::Entry e3([] { printf("e3 should be canceled\n"); });
+    TimingWheel::Entry e4;
+    int refreshed = 0;
+    e4.setCallback([&] {
+        printf("e4 expired at tick %lu\n", wheel.now());
+        // 模拟连接有活动，重新调度
+        if (++refreshed < 3) {
+            wheel.schedule(&e4, 5);
+        }
+    });
+
+    wheel.schedule(&e1, 3);
+    wheel.schedule(&e2, 20);
+    wheel.schedule(&e3, 4);
+    wheel.schedule(&e4, 5);
+    wheel.cancel(&e3);
+    printf("entries: %lu\n", wheel.size());
+
+    loop.runAfter(2.5, [&] {
+        printf("entries: %lu\n", wheel.size());
+        loop.quit();
+    });
+    loop.loop();
+    return 0;
+}